@@ -27,20 +27,20 @@
 
 LOG_MODULE_REGISTER(hello, LOG_LEVEL_DBG);
 
-/* Tracked value */
-bool led;
-float adc_norm;
-
 #define GPIO_PORT	LED1_GPIO_CONTROLLER /* General GPIO Controller */
 #define LED_PIN		LED1_GPIO_PIN /* User LED */
 
 static struct device *gpiob;		/* GPIO device */
 static struct device *adc_dev;
+static struct knot_proxy *norm_proxy;
 
-static void read_adc(struct knot_proxy *proxy)
-{
-	knot_proxy_value_set_basic(proxy, &adc_norm);
-}
+#define LOWER_LIMIT	0.2
+#define UPPER_LIMIT	0.8
+
+/* 1 kHz sampling, averaged into 10 values per second */
+#define ADC_INTERVAL_US	1000
+#define ADC_DECIMATION	100
+#define ADC_RESOLUTION	12
 
 static const struct adc_channel_cfg channel_cfg = {
 	.gain             = ADC_GAIN_1_5,
@@ -50,8 +50,14 @@ static const struct adc_channel_cfg channel_cfg = {
 	.input_positive   = NRF_SAADC_INPUT_AIN7, // Use pin 0.31 as ADC
 };
 
-#define LOWER_LIMIT	0.2
-#define UPPER_LIMIT	0.8
+/* Cloud requests: send last acquisition output */
+static void read_norm(struct knot_proxy *proxy)
+{
+	s32_t norm;
+
+	if (knot_acq_get(channel_cfg.channel_id, &norm))
+		knot_proxy_value_set_q16(proxy, norm);
+}
 
 void setup(void)
 {
@@ -63,39 +69,40 @@ void setup(void)
 	adc_dev = device_get_binding(DT_ADC_0_NAME);
 	adc_channel_setup(adc_dev, &channel_cfg);
 
-	/* Send readings */
-	knot_proxy_register(0, "Norm", KNOT_TYPE_ID_ANGLE,
-			    KNOT_VALUE_TYPE_FLOAT, KNOT_UNIT_ANGLE_DEGREE,
-			    NULL, read_adc);
+	/*
+	 * Send readings. Values come from continuous acquisition, so
+	 * poll callback only runs on cloud requests.
+	 */
+	norm_proxy = knot_proxy_register(0, "Norm", KNOT_TYPE_ID_ANGLE,
+					 KNOT_VALUE_TYPE_FLOAT,
+					 KNOT_UNIT_ANGLE_DEGREE,
+					 NULL, read_norm);
+	knot_proxy_set_sample_period(norm_proxy, KNOT_SAMPLE_ON_DEMAND);
 	knot_proxy_set_config(0,
 			      KNOT_EVT_FLAG_TIME, 20,
 			      KNOT_EVT_FLAG_LOWER_THRESHOLD, LOWER_LIMIT,
 			      KNOT_EVT_FLAG_UPPER_THRESHOLD, UPPER_LIMIT,
 			      NULL);
-}
 
-int16_t adc_buffer;
-
-const struct adc_sequence sequence = {
-	.channels    = BIT(0),
-	.buffer      = &adc_buffer,
-	.buffer_size = sizeof(adc_buffer),
-	.resolution  = 12,
-};
+	/* Normalized reading: mean / 4095 */
+	knot_acq_add_channel(channel_cfg.channel_id, norm_proxy,
+			     KNOT_Q16(1) / 4095);
+	if (knot_acq_start(adc_dev, ADC_RESOLUTION, ADC_INTERVAL_US,
+			   ADC_DECIMATION))
+		LOG_ERR("ADC acquisition failed to start");
+}
 
+/* Woken up on each acquisition output */
 void loop(void)
 {
-	/* Clear buffer and read value*/
-	memset(&adc_buffer, 0, sizeof(adc_buffer));
-	adc_read(adc_dev, &sequence);
+	s32_t norm;
 
-	/* Convert value */
-	adc_norm = (1.0 * adc_buffer)/4095;
+	if (knot_acq_get(channel_cfg.channel_id, &norm) == false)
+		return;
 
 	/* Turn led on if out of limits */
-	if (adc_norm > UPPER_LIMIT || adc_norm < LOWER_LIMIT) {
+	if (norm > KNOT_Q16(UPPER_LIMIT) || norm < KNOT_Q16(LOWER_LIMIT))
 		gpio_pin_write(gpiob, LED_PIN, false);
-	} else {
+	else
 		gpio_pin_write(gpiob, LED_PIN, true);
-	}
 }
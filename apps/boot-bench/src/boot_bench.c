@@ -0,0 +1,38 @@
+/* boot_bench.c - KNoT boot time benchmark */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Minimal app used to measure time from reset to ONLINE state. Boot phases
+ * breakdown is printed by core once ONLINE. On qemu_x86, run
+ * scripts/gateway_stub.py on the host as gateway stand-in.
+ */
+
+#include <zephyr.h>
+
+#include "knot.h"
+#include <knot/knot_types.h>
+#include <knot/knot_protocol.h>
+
+static bool state;
+
+static void poll_state(struct knot_proxy *proxy)
+{
+	knot_proxy_value_set_basic(proxy, &state);
+}
+
+void setup(void)
+{
+	knot_proxy_register(0, "State", KNOT_TYPE_ID_SWITCH,
+			    KNOT_VALUE_TYPE_BOOL, KNOT_UNIT_NOT_APPLICABLE,
+			    NULL, poll_state);
+	knot_proxy_set_config(0, KNOT_EVT_FLAG_CHANGE, NULL);
+}
+
+void loop(void)
+{
+}
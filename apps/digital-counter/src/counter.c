@@ -35,6 +35,10 @@ int counter;			/* Events counter */
 
 struct device *gpio_led;		/* GPIO device */
 struct device *gpio_sensor;		/* GPIO device */
+static struct gpio_callback sensor_cb;	/* Sensor signal callback */
+static struct knot_proxy *counter_proxy;
+
+int64_t last_toggle_time = 0;
 
 void read_led(struct knot_proxy *proxy)
 {
@@ -47,9 +51,19 @@ void write_counter(struct knot_proxy *proxy)
 	LOG_INF("Value for counter changed to %d", counter);
 }
 
-void read_counter(struct knot_proxy *proxy)
+/* Count every signal edge as soon as it happens */
+static void sensor_edge(struct device *gpio_sensor,
+			struct gpio_callback *cb, u32_t pins)
 {
-	knot_proxy_value_set_basic(proxy, &counter);
+	last_toggle_time = k_uptime_get();
+
+	/* Turn led on if vibrating */
+	if (led == false) {
+		led = true;
+		gpio_pin_write(gpio_led, LED_PIN, !led);
+		counter++;
+		knot_proxy_publish_count(counter_proxy, 1);
+	}
 }
 
 void setup(void)
@@ -60,8 +74,12 @@ void setup(void)
 
 	gpio_pin_configure(gpio_led, LED_PIN, GPIO_DIR_OUT);
 
+	/* Sensor pin: interruption on rising edge */
 	gpio_pin_configure(gpio_sensor, SENSOR_PIN,
-			   GPIO_DIR_IN | GPIO_PUD_PULL_DOWN);
+			   GPIO_DIR_IN | GPIO_PUD_PULL_DOWN |
+			   GPIO_INT | GPIO_INT_EDGE | GPIO_INT_ACTIVE_HIGH);
+	gpio_init_callback(&sensor_cb, sensor_edge, BIT(SENSOR_PIN));
+	gpio_add_callback(gpio_sensor, &sensor_cb);
 
 	/* Turn off led */
 	led = false;
@@ -75,39 +93,33 @@ void setup(void)
 			    NULL, read_led);
 	knot_proxy_set_config(0, KNOT_EVT_FLAG_CHANGE, NULL);
 
-	/* KNoT config - Counter*/
-	knot_proxy_register(1, "Counter", KNOT_TYPE_ID_TEMPERATURE,
-		            KNOT_VALUE_TYPE_INT, KNOT_UNIT_TEMPERATURE_C,
-		            write_counter, read_counter);
+	/* KNoT config - Counter. Counted from sensor interruption */
+	counter_proxy = knot_proxy_register(1, "Counter",
+					    KNOT_TYPE_ID_TEMPERATURE,
+					    KNOT_VALUE_TYPE_INT,
+					    KNOT_UNIT_TEMPERATURE_C,
+					    write_counter, NULL);
+	knot_proxy_publish_count(counter_proxy, 0);
 	knot_proxy_set_config(1,
 			      KNOT_EVT_FLAG_TIME, 30,
 			      KNOT_EVT_FLAG_UPPER_THRESHOLD, 10, NULL);
-}
 
-int64_t last_toggle_time = 0;
+	gpio_pin_enable_callback(gpio_sensor, SENSOR_PIN);
+
+	/* Led turned off by loop() */
+	knot_app_set_loop_period(100);
+}
 
 void loop(void)
 {
-	/* Get current time */
-	u32_t sensor;
-	int64_t current_time = k_uptime_get();
-
-	/* Turn led on if vibrating */
-	gpio_pin_read(gpio_sensor, SENSOR_PIN, &sensor);
-	if (sensor) {
-		last_toggle_time = current_time;
-		LOG_INF("SIGNAL RECEIVED");
-		if (led == false) {
-			led = true;
-			gpio_pin_write(gpio_led, LED_PIN, !led);
-			counter++;
-		}
-	}
+	unsigned int key;
 
-	/* Turn led off after 1 second */
+	/* Turn led off after 1 second. Both are written on sensor ISR */
+	key = irq_lock();
 	if (led == true &&
-	    current_time - last_toggle_time > 1000) {
+	    k_uptime_get() - last_toggle_time > 1000) {
 		led = false;
 		gpio_pin_write(gpio_led, LED_PIN, !led);
 	}
+	irq_unlock(key);
 }
@@ -56,6 +56,9 @@ void setup(void)
 
 	knot_proxy_set_config(0, KNOT_EVT_FLAG_CHANGE, NULL);
 
+	/* Led blinking checked by loop() */
+	knot_app_set_loop_period(100);
+
 }
 
 int64_t last_toggle_time = 0;
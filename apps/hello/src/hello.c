@@ -38,6 +38,7 @@ static bool led = true;
 
 static struct device *gpiob;		/* GPIO device */
 static struct gpio_callback button_cb; /* Button pressed callback */
+static struct knot_proxy *led_proxy;
 
 static void btn_press(struct device *gpiob,
 		       struct gpio_callback *cb, u32_t pins)
@@ -45,6 +46,8 @@ static void btn_press(struct device *gpiob,
 	led = !led;
 	gpio_pin_write(gpiob, LED_PIN, !led); /* Update GPIO */
 
+	/* Send new value without waiting for next poll */
+	knot_proxy_publish(led_proxy, &led);
 }
 #else
 
@@ -84,12 +87,14 @@ static void poll_led(struct knot_proxy *proxy)
 
 void setup(void)
 {
+	struct knot_proxy *proxy;
 	bool success;
 
 	/* BUTTON - Sent after change */
-	if (knot_proxy_register(0, "LED", KNOT_TYPE_ID_SWITCH,
+	proxy = knot_proxy_register(0, "LED", KNOT_TYPE_ID_SWITCH,
 		      KNOT_VALUE_TYPE_BOOL, KNOT_UNIT_NOT_APPLICABLE,
-		      changed_led, poll_led) == NULL) {
+		      changed_led, poll_led);
+	if (proxy == NULL) {
 		LOG_ERR("LED failed to register");
 	}
 	success = knot_proxy_set_config(0, KNOT_EVT_FLAG_CHANGE, NULL);
@@ -98,6 +103,8 @@ void setup(void)
 
 	/* Peripherals control */
 #if CONFIG_BOARD_NRF52840_PCA10056
+	led_proxy = proxy;
+
 	/* Read button */
 	gpiob = device_get_binding(GPIO_PORT);
 	/* Button Pin has pull up, interruption on low edge and debounce */
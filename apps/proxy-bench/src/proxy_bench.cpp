@@ -0,0 +1,258 @@
+/* proxy_bench.cpp - KNoT proxy API call overhead benchmark */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Compares cycles per call of knot_proxy_value_set_basic(), the typed C
+ * setter and the C++ wrapper on int proxies. Values change on every call
+ * so the whole evaluation runs. Bulk evaluation of a scan of int samples
+ * is compared against one typed call per sample, with samples kept within
+ * limits so nothing is sent. Float proxy evaluation and the round trip
+ * to a thread with and without FPU context are measured for comparing
+ * builds with and without CONFIG_KNOT_FLOAT_FIXED. Results are printed
+ * once at setup().
+ */
+
+#include <zephyr.h>
+#include <misc/printk.h>
+
+#include "knot.hpp"
+
+#define BENCH_CALLS	1000
+
+/* Proxies evaluated as one ADC scan */
+#define SCAN_FIRST_ID	2
+#define SCAN_LEN	16
+#define SCAN_LIMIT	1000
+
+#define FLOAT_ID	(SCAN_FIRST_ID + SCAN_LEN)
+
+#define PONG_STACK_SIZE	512
+
+static knot::Proxy<int32_t, knot::Celsius> typed;
+static struct knot_proxy *basic;
+static struct knot_proxy *scan[SCAN_LEN];
+static s32_t samples[SCAN_LEN];
+static struct knot_proxy *analog;
+
+static K_THREAD_STACK_DEFINE(pong_stack, PONG_STACK_SIZE);
+static struct k_thread pong_thread;
+static struct k_sem ping_sem;
+static struct k_sem pong_sem;
+
+static u32_t bench_basic(void)
+{
+	u32_t start = k_cycle_get_32();
+	s32_t i;
+
+	for (i = 0; i < BENCH_CALLS; i++)
+		knot_proxy_value_set_basic(basic, &i);
+
+	return k_cycle_get_32() - start;
+}
+
+static u32_t bench_typed_c(void)
+{
+	u32_t start = k_cycle_get_32();
+	s32_t i;
+
+	for (i = 0; i < BENCH_CALLS; i++)
+		knot_proxy_value_set_int(basic, i);
+
+	return k_cycle_get_32() - start;
+}
+
+static u32_t bench_typed_cpp(void)
+{
+	u32_t start = k_cycle_get_32();
+	s32_t i;
+
+	for (i = 0; i < BENCH_CALLS; i++)
+		typed.set(i);
+
+	return k_cycle_get_32() - start;
+}
+
+/* Samples change on every scan but stay within limits */
+static void fill_scan(s32_t round)
+{
+	int i;
+
+	for (i = 0; i < SCAN_LEN; i++)
+		samples[i] = (round + i) % SCAN_LIMIT;
+}
+
+static u32_t bench_scan_per_call(void)
+{
+	u32_t cycles = 0;
+	u32_t start;
+	s32_t round;
+	int i;
+
+	for (round = 0; round < BENCH_CALLS; round++) {
+		fill_scan(round);
+
+		start = k_cycle_get_32();
+		for (i = 0; i < SCAN_LEN; i++)
+			knot_proxy_value_set_int(scan[i], samples[i]);
+		cycles += k_cycle_get_32() - start;
+	}
+
+	return cycles;
+}
+
+static u32_t bench_scan_bulk(void)
+{
+	u32_t send_map[DIV_ROUND_UP(SCAN_LEN, 32)];
+	u32_t cycles = 0;
+	u32_t start;
+	s32_t round;
+
+	for (round = 0; round < BENCH_CALLS; round++) {
+		fill_scan(round);
+
+		start = k_cycle_get_32();
+		knot_proxy_value_set_bulk(SCAN_FIRST_ID, SCAN_LEN, samples, NULL,
+					  send_map);
+		cycles += k_cycle_get_32() - start;
+	}
+
+	return cycles;
+}
+
+static bool register_scan(void)
+{
+	u8_t id;
+	int i;
+
+	for (i = 0; i < SCAN_LEN; i++) {
+		id = SCAN_FIRST_ID + i;
+		scan[i] = knot_proxy_register(id, "Scan",
+					      KNOT_TYPE_ID_TEMPERATURE,
+					      KNOT_VALUE_TYPE_INT,
+					      KNOT_UNIT_TEMPERATURE_C,
+					      NULL, NULL);
+		if (scan[i] == NULL)
+			return false;
+
+		knot_proxy_set_config(id,
+			KNOT_EVT_FLAG_LOWER_THRESHOLD, -SCAN_LIMIT,
+			KNOT_EVT_FLAG_UPPER_THRESHOLD, SCAN_LIMIT, NULL);
+	}
+
+	return true;
+}
+
+/* Float samples given as Q16.16: no float math with fixed point path */
+static u32_t bench_float_q16(void)
+{
+	u32_t start = k_cycle_get_32();
+	s32_t i;
+
+	for (i = 0; i < BENCH_CALLS; i++)
+		knot_proxy_value_set_q16(analog, i << 8);
+
+	return k_cycle_get_32() - start;
+}
+
+#if !CONFIG_KNOT_FLOAT_FIXED
+static u32_t bench_float(void)
+{
+	u32_t start = k_cycle_get_32();
+	s32_t i;
+
+	for (i = 0; i < BENCH_CALLS; i++)
+		knot_proxy_value_set_float(analog, i / 256.0f);
+
+	return k_cycle_get_32() - start;
+}
+#endif
+
+static void pong(void *p1, void *p2, void *p3)
+{
+	while (1) {
+		k_sem_take(&ping_sem, K_FOREVER);
+		k_sem_give(&pong_sem);
+	}
+}
+
+/*
+ * Round trip to a higher priority thread: two context switches. FPU
+ * registers are saved for each side created with K_FP_REGS, including
+ * this thread unless CONFIG_KNOT_FLOAT_FIXED is set.
+ */
+static u32_t bench_switch(u32_t options)
+{
+	u32_t start;
+	u32_t cycles;
+	int i;
+
+	k_sem_init(&ping_sem, 0, 1);
+	k_sem_init(&pong_sem, 0, 1);
+	k_thread_create(&pong_thread, pong_stack,
+			K_THREAD_STACK_SIZEOF(pong_stack), pong,
+			NULL, NULL, NULL, K_PRIO_PREEMPT(14), options,
+			K_NO_WAIT);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_CALLS; i++) {
+		k_sem_give(&ping_sem);
+		k_sem_take(&pong_sem, K_FOREVER);
+	}
+	cycles = k_cycle_get_32() - start;
+
+	k_thread_abort(&pong_thread);
+
+	return cycles;
+}
+
+static void report(const char *name, u32_t cycles, u32_t calls)
+{
+	printk("%-12s %u cycles/call\n", name, cycles / calls);
+}
+
+void setup(void)
+{
+	basic = knot_proxy_register(0, "Basic", KNOT_TYPE_ID_TEMPERATURE,
+				    KNOT_VALUE_TYPE_INT,
+				    KNOT_UNIT_TEMPERATURE_C, NULL, NULL);
+	analog = knot_proxy_register(FLOAT_ID, "Float", KNOT_TYPE_ID_ANGLE,
+				     KNOT_VALUE_TYPE_FLOAT,
+				     KNOT_UNIT_ANGLE_DEGREE, NULL, NULL);
+	if (basic == NULL || !typed.attach(1, "Typed") || !register_scan() ||
+	    analog == NULL) {
+		printk("Proxy bench: register failed\n");
+		return;
+	}
+
+	knot_proxy_set_config(0, KNOT_EVT_FLAG_CHANGE, NULL);
+	knot_proxy_set_config(1, KNOT_EVT_FLAG_CHANGE, NULL);
+	knot_proxy_set_config(FLOAT_ID, KNOT_EVT_FLAG_CHANGE, NULL);
+
+	report("set_basic", bench_basic(), BENCH_CALLS);
+	report("set_int", bench_typed_c(), BENCH_CALLS);
+	report("Proxy::set", bench_typed_cpp(), BENCH_CALLS);
+
+	/* Per sample of a scan */
+	report("scan set_int", bench_scan_per_call(), BENCH_CALLS * SCAN_LEN);
+	report("scan bulk", bench_scan_bulk(), BENCH_CALLS * SCAN_LEN);
+
+	report("set_q16", bench_float_q16(), BENCH_CALLS);
+#if !CONFIG_KNOT_FLOAT_FIXED
+	report("set_float", bench_float(), BENCH_CALLS);
+#endif
+
+	/* Per round trip */
+	report("switch", bench_switch(0), BENCH_CALLS);
+#if CONFIG_FP_SHARING
+	report("switch fp", bench_switch(K_FP_REGS), BENCH_CALLS);
+#endif
+}
+
+void loop(void)
+{
+}
@@ -0,0 +1,136 @@
+/* ring_bench.c - KNoT PROTO/NET message ring benchmark */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Compares the ring used between PROTO and NET threads against the k_pipe
+ * used before. Messages are put and read back by the same thread, costing
+ * copies and locking only, and handed over to a higher priority thread
+ * waiting for them, adding its wakeup and two context switches. Results
+ * are printed once at setup().
+ */
+
+#include <zephyr.h>
+#include <misc/printk.h>
+
+#include "ring.h"
+
+#define BENCH_MSGS	1000
+#define MSG_LEN		32
+
+#define SINK_STACK_SIZE	(512 + RING_SLOT_SIZE)
+
+/* Same size as PROTO/NET pipes */
+K_PIPE_DEFINE(pipe, RING_SLOT_SIZE, 4);
+static struct ring ring;
+
+static K_THREAD_STACK_DEFINE(sink_stack, SINK_STACK_SIZE);
+static struct k_thread sink_thread;
+static K_SEM_DEFINE(sink_done, 0, 1);
+
+static u8_t msg[MSG_LEN];
+
+static u32_t bench_ring(void)
+{
+	u32_t start = k_cycle_get_32();
+	u8_t buf[RING_SLOT_SIZE];
+	int i;
+
+	for (i = 0; i < BENCH_MSGS; i++) {
+		ring_put(&ring, msg, sizeof(msg));
+		ring_get(&ring, buf, sizeof(buf), K_NO_WAIT);
+	}
+
+	return k_cycle_get_32() - start;
+}
+
+static u32_t bench_pipe(void)
+{
+	u32_t start = k_cycle_get_32();
+	u8_t buf[RING_SLOT_SIZE];
+	size_t len;
+	int i;
+
+	for (i = 0; i < BENCH_MSGS; i++) {
+		k_pipe_put(&pipe, msg, sizeof(msg), &len, sizeof(msg),
+			   K_NO_WAIT);
+		k_pipe_get(&pipe, buf, sizeof(buf), &len, 0, K_NO_WAIT);
+	}
+
+	return k_cycle_get_32() - start;
+}
+
+static void ring_sink(void *p1, void *p2, void *p3)
+{
+	u8_t buf[RING_SLOT_SIZE];
+	int i;
+
+	for (i = 0; i < BENCH_MSGS; i++)
+		ring_get(&ring, buf, sizeof(buf), K_FOREVER);
+
+	k_sem_give(&sink_done);
+}
+
+static void pipe_sink(void *p1, void *p2, void *p3)
+{
+	u8_t buf[RING_SLOT_SIZE];
+	size_t len;
+	int i;
+
+	for (i = 0; i < BENCH_MSGS; i++)
+		k_pipe_get(&pipe, buf, MSG_LEN, &len, MSG_LEN, K_FOREVER);
+
+	k_sem_give(&sink_done);
+}
+
+/* Sink preempts this thread on every message */
+static u32_t bench_handover(k_thread_entry_t sink, bool use_ring)
+{
+	u32_t start;
+	size_t len;
+	int i;
+
+	k_thread_create(&sink_thread, sink_stack,
+			K_THREAD_STACK_SIZEOF(sink_stack), sink,
+			NULL, NULL, NULL, K_PRIO_PREEMPT(14), 0, K_NO_WAIT);
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_MSGS; i++) {
+		if (use_ring)
+			ring_put(&ring, msg, sizeof(msg));
+		else
+			k_pipe_put(&pipe, msg, sizeof(msg), &len,
+				   sizeof(msg), K_NO_WAIT);
+	}
+	k_sem_take(&sink_done, K_FOREVER);
+
+	return k_cycle_get_32() - start;
+}
+
+static void report(const char *name, u32_t cycles)
+{
+	u32_t rate;
+
+	rate = (u64_t) BENCH_MSGS * sys_clock_hw_cycles_per_sec() / cycles;
+	printk("%-14s %u cycles/msg %u msgs/s\n", name, cycles / BENCH_MSGS,
+	       rate);
+}
+
+void setup(void)
+{
+	ring_init(&ring);
+
+	printk("Ring bench: %d messages of %d bytes\n", BENCH_MSGS, MSG_LEN);
+	report("ring", bench_ring());
+	report("pipe", bench_pipe());
+	report("ring handover", bench_handover(ring_sink, true));
+	report("pipe handover", bench_handover(pipe_sink, false));
+}
+
+void loop(void)
+{
+}
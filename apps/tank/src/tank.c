@@ -65,14 +65,19 @@ static void poll_volume(struct knot_proxy *proxy)
 
 void setup(void)
 {
+	struct knot_proxy *proxy;
 	bool success;
 
 	/* VOLUME - Sent every 5 seconds or at low volumes */
-	if (knot_proxy_register(0, "VOLUME", KNOT_TYPE_ID_VOLUME,
+	proxy = knot_proxy_register(0, "VOLUME", KNOT_TYPE_ID_VOLUME,
 		      KNOT_VALUE_TYPE_FLOAT, KNOT_UNIT_VOLUME_L,
-		      changed_volume, poll_volume) == NULL) {
+		      changed_volume, poll_volume);
+	if (proxy == NULL)
 		LOG_ERR("VOLUME_0 failed to register");
-	}
+
+	/* Volume is read once a second */
+	knot_proxy_set_sample_period(proxy, 1000);
+
 	success = knot_proxy_set_config(0, KNOT_EVT_FLAG_TIME, 5, NULL);
 	if (!success)
 		LOG_ERR("VOLUME failed to configure");
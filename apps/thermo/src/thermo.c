@@ -56,14 +56,19 @@ static void poll_thermo(struct knot_proxy *proxy)
 
 void setup(void)
 {
+	struct knot_proxy *proxy;
 	bool success;
 
 	/* THERMO - Sent every 5 seconds or at high temperatures */
-	if (knot_proxy_register(0, "THERMO", KNOT_TYPE_ID_TEMPERATURE,
+	proxy = knot_proxy_register(0, "THERMO", KNOT_TYPE_ID_TEMPERATURE,
 		      KNOT_VALUE_TYPE_INT, KNOT_UNIT_TEMPERATURE_C,
-		      changed_thermo, poll_thermo) == NULL) {
+		      changed_thermo, poll_thermo);
+	if (proxy == NULL)
 		LOG_ERR("THERMO_0 failed to register");
-	}
+
+	/* Temperature is read once a second */
+	knot_proxy_set_sample_period(proxy, 1000);
+
 	success = knot_proxy_set_config(0, KNOT_EVT_FLAG_TIME, 5,
 					KNOT_EVT_FLAG_UPPER_THRESHOLD,
 					high_temp, NULL);
@@ -0,0 +1,194 @@
+/* acq.c - Continuous ADC acquisition feeding proxies */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * A single sampling sequence over all channels is repeated from the ADC
+ * callback, paced by the sequence interval. Each sampling is added to a
+ * per-channel accumulator on the callback, so raw samples never reach a
+ * thread. Every 'decimation' samplings the mean of each channel is
+ * staged to its proxy, to be evaluated by the KNoT thread, and the app
+ * loop() is woken up.
+ */
+
+#if CONFIG_KNOT_ACQ
+#include <zephyr.h>
+#include <string.h>
+#include <logging/log.h>
+#include <adc.h>
+
+#include "knot.h"
+
+LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
+
+static struct acq_channel {
+	u8_t			id; /* ADC channel */
+	struct knot_proxy	*proxy;
+	s32_t			scale; /* Q16.16 applied to mean */
+	s64_t			acc; /* Sum of current block */
+	s32_t			out; /* Last output as Q16.16 */
+	bool			valid; /* 'out' set since start */
+} channels[CONFIG_KNOT_ACQ_CHANNELS_MAX];
+
+static u8_t channels_count;
+static u16_t block_len; /* Samplings per output */
+static u16_t block_count;
+static bool running;
+static bool stopping;
+
+/* One sample per channel, ordered by channel id */
+static s16_t samples[CONFIG_KNOT_ACQ_CHANNELS_MAX];
+
+static struct device *adc_dev;
+
+static void publish_block(void)
+{
+	struct acq_channel *ch;
+	s64_t out;
+	int i;
+
+	for (i = 0; i < channels_count; i++) {
+		ch = &channels[i];
+		out = (ch->acc * ch->scale) / block_len;
+		ch->out = (s32_t) MIN(MAX(out, INT32_MIN), INT32_MAX);
+		ch->acc = 0;
+		ch->valid = true;
+
+		knot_proxy_value_complete_q16(ch->proxy, ch->out);
+	}
+
+	knot_app_wakeup();
+}
+
+/* Called from ADC ISR after each sampling */
+static enum adc_action acq_done(struct device *dev,
+				const struct adc_sequence *sequence,
+				u16_t sampling_index)
+{
+	int i;
+
+	if (stopping) {
+		running = false;
+		return ADC_ACTION_FINISH;
+	}
+
+	for (i = 0; i < channels_count; i++)
+		channels[i].acc += samples[i];
+
+	if (++block_count == block_len) {
+		block_count = 0;
+		publish_block();
+	}
+
+	/* Sample again on same buffer after interval */
+	return ADC_ACTION_REPEAT;
+}
+
+static struct adc_sequence_options options = {
+	.callback = acq_done,
+};
+
+static struct adc_sequence sequence = {
+	.buffer = samples,
+	.options = &options,
+};
+
+int knot_acq_add_channel(u8_t channel_id, struct knot_proxy *proxy,
+			 s32_t scale)
+{
+	int i;
+
+	if (running || proxy == NULL)
+		return -EINVAL;
+
+	if (channels_count == CONFIG_KNOT_ACQ_CHANNELS_MAX) {
+		LOG_ERR("Acquisition channel %d failed: "
+			"CONFIG_KNOT_ACQ_CHANNELS_MAX (%d) reached",
+			channel_id, CONFIG_KNOT_ACQ_CHANNELS_MAX);
+		return -ENOMEM;
+	}
+
+	/* Keep channels in the order samples are written by the driver */
+	for (i = channels_count; i > 0; i--) {
+		if (channels[i - 1].id == channel_id)
+			return -EALREADY;
+		if (channels[i - 1].id < channel_id)
+			break;
+		channels[i] = channels[i - 1];
+	}
+
+	memset(&channels[i], 0, sizeof(channels[i]));
+	channels[i].id = channel_id;
+	channels[i].proxy = proxy;
+	channels[i].scale = scale;
+	channels_count++;
+
+	return 0;
+}
+
+int knot_acq_start(struct device *adc, u8_t resolution, u32_t interval_us,
+		   u16_t decimation)
+{
+	int ret;
+	int i;
+
+	if (running || adc == NULL || channels_count == 0 || decimation == 0)
+		return -EINVAL;
+
+	adc_dev = adc;
+	block_len = decimation;
+	block_count = 0;
+	stopping = false;
+
+	sequence.channels = 0;
+	for (i = 0; i < channels_count; i++) {
+		sequence.channels |= BIT(channels[i].id);
+		channels[i].acc = 0;
+		channels[i].valid = false;
+	}
+
+	sequence.buffer_size = channels_count * sizeof(samples[0]);
+	sequence.resolution = resolution;
+	options.interval_us = interval_us;
+
+	running = true;
+	ret = adc_read_async(adc_dev, &sequence, NULL);
+	if (ret) {
+		LOG_ERR("Acquisition start failed (err %d)", ret);
+		running = false;
+	}
+
+	return ret;
+}
+
+void knot_acq_stop(void)
+{
+	/* Finished on next sampling */
+	stopping = true;
+}
+
+bool knot_acq_get(u8_t channel_id, s32_t *value)
+{
+	unsigned int key;
+	bool valid;
+	int i;
+
+	for (i = 0; i < channels_count; i++) {
+		if (channels[i].id != channel_id)
+			continue;
+
+		key = irq_lock();
+		valid = channels[i].valid;
+		*value = channels[i].out;
+		irq_unlock(key);
+
+		return valid;
+	}
+
+	return false;
+}
+#endif
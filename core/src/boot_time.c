@@ -0,0 +1,87 @@
+/* boot_time.c - KNoT boot phases profiling */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Uptime of each boot phase is kept on a RAM buffer not cleared on start,
+ * so the record of a boot that did not reach ONLINE state is still
+ * available after a warm reboot.
+ */
+
+#if CONFIG_KNOT_BOOT_TIME
+#include <zephyr.h>
+#include <string.h>
+#include <misc/printk.h>
+
+#include "boot_time.h"
+
+#define BOOT_TIME_MAGIC		0x4B425431	/* "KBT1" */
+
+static const char * const phase_name[BOOT_TIME_MAX] = {
+	[BOOT_TIME_START]	= "start",
+	[BOOT_TIME_SETTINGS]	= "settings",
+	[BOOT_TIME_NET_INIT]	= "net init",
+	[BOOT_TIME_NET_READY]	= "net ready",
+	[BOOT_TIME_CONNECTED]	= "connected",
+	[BOOT_TIME_AUTH]	= "auth",
+	[BOOT_TIME_ONLINE]	= "online",
+};
+
+static __noinit struct {
+	u32_t magic;
+	u32_t uptime[BOOT_TIME_MAX];	/* Uptime in ms. 0 if not reached */
+	bool reported;
+} record;
+
+static void print_record(const char *title)
+{
+	u32_t last = 0;
+	int i;
+
+	printk("KNoT boot time (%s):\n", title);
+	for (i = 0; i < BOOT_TIME_MAX; i++) {
+		if (record.uptime[i] == 0) {
+			printk("  %-10s not reached\n", phase_name[i]);
+			continue;
+		}
+
+		printk("  %-10s %6u ms (+%u ms)\n", phase_name[i],
+		       record.uptime[i], record.uptime[i] - last);
+		last = record.uptime[i];
+	}
+}
+
+void boot_time_init(void)
+{
+	/* Report previous boot if it did not get to report itself */
+	if (record.magic == BOOT_TIME_MAGIC && record.reported == false)
+		print_record("previous boot");
+
+	memset(&record, 0, sizeof(record));
+	record.magic = BOOT_TIME_MAGIC;
+	boot_time_mark(BOOT_TIME_START);
+}
+
+void boot_time_mark(enum boot_time_phase phase)
+{
+	/* Only first time each phase is reached is kept */
+	if (phase >= BOOT_TIME_MAX || record.uptime[phase])
+		return;
+
+	/* Uptime 0 is used as not reached */
+	record.uptime[phase] = k_uptime_get_32() ? : 1;
+}
+
+void boot_time_report(void)
+{
+	if (record.reported)
+		return;
+
+	record.reported = true;
+	print_record("this boot");
+}
+#endif
@@ -0,0 +1,29 @@
+/* boot_time.h - KNoT boot phases profiling */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Phases in the order they happen from reset to ONLINE state */
+enum boot_time_phase {
+	BOOT_TIME_START = 0,		/* Main started */
+	BOOT_TIME_SETTINGS,		/* Settings loaded */
+	BOOT_TIME_NET_INIT,		/* Network stack started */
+	BOOT_TIME_NET_READY,		/* OpenThread attached */
+	BOOT_TIME_CONNECTED,		/* Connected to gateway */
+	BOOT_TIME_AUTH,			/* Registered or authenticated */
+	BOOT_TIME_ONLINE,		/* Schema sent and ONLINE */
+	BOOT_TIME_MAX
+};
+
+#if CONFIG_KNOT_BOOT_TIME
+void boot_time_init(void);
+void boot_time_mark(enum boot_time_phase phase);
+void boot_time_report(void);
+#else
+static inline void boot_time_init(void) { }
+static inline void boot_time_mark(enum boot_time_phase phase) { }
+static inline void boot_time_report(void) { }
+#endif
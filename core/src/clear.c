@@ -11,6 +11,7 @@
 #include <flash.h>
 
 #include "storage.h"
+#include "retained.h"
 #include "clear.h"
 
 LOG_MODULE_REGISTER(knot_clear, CONFIG_KNOT_LOG_LEVEL);
@@ -65,9 +66,15 @@ static int clear_settings(void)
 
 int clear_factory(void)
 {
+	s64_t start_time;
 	int rc;
 	int ret = 0;
 
+	start_time = k_uptime_get();
+
+	/* Next boot must check settings again */
+	retained_set_provisioned(false);
+
 	rc = storage_reset();
 	if (rc)
 		ret = -1;
@@ -76,14 +83,23 @@ int clear_factory(void)
 	if (rc)
 		ret = -1;
 
+	/* Always erased: OpenThread dataset holds the network master key */
 	rc = clear_ot_nvs();
 	if (rc)
 		ret = -1;
 
+	/* Records invalidated: erasing is left to garbage collection */
+	if (IS_ENABLED(CONFIG_KNOT_FACTORY_RESET_FAST) && ret == 0)
+		goto done;
+
 	rc = clear_settings();
 	if (rc)
 		ret = -1;
 
+done:
+	LOG_INF("Factory reset took %d ms",
+		(int) (k_uptime_get() - start_time));
+
 	return ret;
 }
 #endif
@@ -6,15 +6,29 @@
 
 /*
  * Similar to Arduino:
- * setup() is called once and loop() is always called at idle state.
+ * setup() is called once and loop() is called at idle state.
  * Sensors and actuactors should be registered at setup() function
  * definition and loop() must NOT be blooking.
  *
  * setup() and loop() must be defined at user app context.
  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void setup(void);
 void loop(void);
 
+/*
+ * loop() runs once after setup(), then every 'period' ms and whenever
+ * knot_app_wakeup() is called (safe from ISRs). Period 0 (default) runs
+ * it on wakeup only. The KNoT thread sleeps in between unless proxies
+ * or the network need it. Ignored if CONFIG_KNOT_LOOP_EVERY_PASS is set.
+ */
+void knot_app_set_loop_period(u32_t period);
+void knot_app_wakeup(void);
+
 /* Proxy: Virtual representation of the remote device */
 struct knot_proxy;
 
@@ -42,12 +56,134 @@ u8_t knot_proxy_get_id(struct knot_proxy *proxy);
 /* Proxy helpers to get or set sensor data at the remote */
 bool knot_proxy_value_set_basic(struct knot_proxy *proxy,
 				const void *value);
+
+/* Typed setters: skip value type dispatch of set_basic() */
+bool knot_proxy_value_set_bool(struct knot_proxy *proxy, bool value);
+bool knot_proxy_value_set_int(struct knot_proxy *proxy, s32_t value);
+bool knot_proxy_value_set_float(struct knot_proxy *proxy, float value);
+
 bool knot_proxy_value_set_string(struct knot_proxy *proxy,
 				 const char *value, int len);
 
+/*
+ * Bulk evaluation of int samples for proxies 'first_id' to
+ * 'first_id + count - 1', as from a single ADC scan. A change is only
+ * considered when sample 'n' differs from the last sent value by more
+ * than 'deadbands[n]'. 'deadbands' may be NULL to consider any change.
+ * Bit 'n' of 'send_map' (one u32_t per 32 proxies) is set if proxy
+ * 'first_id + n' will send its sample. Must be called from the same
+ * context as knot_proxy_value_set_basic().
+ *
+ * @return Amount of proxies sending or negative error.
+ */
+int knot_proxy_value_set_bulk(u8_t first_id, u8_t count,
+			      const s32_t *samples, const s32_t *deadbands,
+			      u32_t *send_map);
+
+/*
+ * Sampling period: poll callback is called at most once every 'period'
+ * ms instead of on every pass of the KNoT thread. Values waiting to be
+ * sent or requested by cloud are still polled right away. 0 (default)
+ * polls every CONFIG_KNOT_PASS_PERIOD ms. KNOT_SAMPLE_ON_DEMAND only
+ * polls on request.
+ */
+#define KNOT_SAMPLE_ON_DEMAND	0xffffffff
+
+bool knot_proxy_set_sample_period(struct knot_proxy *proxy, u32_t period);
+
+/* Poll proxy on next pass regardless of its period. Safe from ISRs */
+void knot_proxy_sample_request(struct knot_proxy *proxy);
+
+/*
+ * Float proxies as Q16.16 fixed point (value * 65536). With
+ * CONFIG_KNOT_FLOAT_FIXED these never touch FPU registers.
+ */
+#define KNOT_Q16(val)		((s32_t) ((val) * 65536))
+
+/*
+ * As knot_proxy_set_config(), with float proxy limits given as Q16.16
+ * int instead of double.
+ */
+bool knot_proxy_set_config_q16(u8_t id, ...);
+
+bool knot_proxy_value_set_q16(struct knot_proxy *proxy, s32_t value);
+bool knot_proxy_value_get_q16(struct knot_proxy *proxy, s32_t *value);
+
+/* As knot_proxy_value_complete() for int or float proxies. Safe from ISRs */
+bool knot_proxy_value_complete_q16(struct knot_proxy *proxy, s32_t value);
+
+/*
+ * Asynchronous sampling: the poll callback may only start a measurement
+ * (ADC, I2C, sensor trigger) and return. Once the sample is ready, complete
+ * it with this function, which is safe to call from ISRs. The value is then
+ * evaluated as by knot_proxy_value_set_basic() from the KNoT thread.
+ *
+ * @param proxy Proxy of basic value type (bool, int or float).
+ * @param value Pointer to the sampled value.
+ */
+bool knot_proxy_value_complete(struct knot_proxy *proxy, const void *value);
+
+/*
+ * ISR-safe publish: stage a new value to be sent on the next KNoT thread
+ * iteration, regardless of the configured events.
+ */
+bool knot_proxy_publish(struct knot_proxy *proxy, const void *value);
+
+/*
+ * ISR-safe counter: add 'delta' to an int proxy total. Every increment is
+ * kept until it is read, and the total is evaluated against the proxy
+ * config. Once used, the proxy total is owned by the SDK.
+ */
+bool knot_proxy_publish_count(struct knot_proxy *proxy, s32_t delta);
+
+/*
+ * Value history: keep the last 'size' values given to
+ * knot_proxy_value_set_basic(), taken from a pool shared by all proxies
+ * (CONFIG_KNOT_PROXY_HISTORY_POOL samples). Enable at setup().
+ */
+bool knot_proxy_history_enable(struct knot_proxy *proxy, u8_t size);
+
+/*
+ * Copy up to 'len' values, newest first, to 'values' array of the proxy
+ * value type (bool, s32_t or float). Returns amount of values copied.
+ */
+int knot_proxy_history_get(struct knot_proxy *proxy, void *values, u8_t len);
+
+/* Stats of values kept on history. Only int and float proxies */
+struct knot_proxy_stats {
+	u8_t count;
+	union {
+		s32_t val_i;
+		float val_f;
+	} min, max, mean;
+};
+
+bool knot_proxy_history_stats(struct knot_proxy *proxy,
+			      struct knot_proxy_stats *stats);
+
+/*
+ * Continuous ADC acquisition (CONFIG_KNOT_ACQ). Channels set up by the
+ * app with adc_channel_setup() are sampled every 'interval_us' and
+ * 'decimation' samples are averaged into one output, published to the
+ * channel proxy as mean * 'scale' (Q16.16). Int proxies get the integer
+ * part. loop() is woken up on each output.
+ */
+struct device;
+
+int knot_acq_add_channel(u8_t channel_id, struct knot_proxy *proxy,
+			 s32_t scale);
+int knot_acq_start(struct device *adc, u8_t resolution, u32_t interval_us,
+		   u16_t decimation);
+void knot_acq_stop(void);
+
+/* Last output of channel as Q16.16. False until first output */
+bool knot_acq_get(u8_t channel_id, s32_t *value);
+
 bool knot_proxy_value_get_basic(struct knot_proxy *proxy,
 				void *value);
 bool knot_proxy_value_get_string(struct knot_proxy *proxy,
 				 char *value, int len, int *olen);
 
-
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,210 @@
+/* knot.hpp - Typed C++ wrapper for KNoT proxies */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Header only. Value type and unit are template parameters, so invalid combinations
+ * fail at compile time and values are set through typed functions
+ * without the 'void *' dispatch of knot_proxy_value_set_basic():
+ *
+ *	static knot::Proxy<int32_t, knot::Celsius> thermo;
+ *
+ *	void setup(void)
+ *	{
+ *		thermo.attach(0, "THERMO", changed_thermo, poll_thermo);
+ *	}
+ *
+ * Callbacks still receive 'struct knot_proxy *'. Wrap it with the same
+ * Proxy type to access the value.
+ */
+
+#ifndef KNOT_HPP
+#define KNOT_HPP
+
+#include <zephyr.h>
+
+extern "C" {
+#include <knot/knot_types.h>
+#include <knot/knot_protocol.h>
+}
+
+#include "knot.h"
+
+namespace knot {
+
+namespace detail {
+
+/*
+ * KNoT value type of C++ types. 32 bits int or long (int32_t may be
+ * either) map to int, and are passed on as 'type'.
+ */
+template <typename T>
+struct value_type {
+	static constexpr bool supported = false;
+	static constexpr u8_t id = 0xff;
+};
+
+template <>
+struct value_type<bool> {
+	static constexpr bool supported = true;
+	static constexpr u8_t id = KNOT_VALUE_TYPE_BOOL;
+	typedef bool type;
+};
+
+template <>
+struct value_type<int> {
+	static constexpr bool supported = (sizeof(int) == sizeof(s32_t));
+	static constexpr u8_t id = KNOT_VALUE_TYPE_INT;
+	typedef s32_t type;
+};
+
+template <>
+struct value_type<long> {
+	static constexpr bool supported = (sizeof(long) == sizeof(s32_t));
+	static constexpr u8_t id = KNOT_VALUE_TYPE_INT;
+	typedef s32_t type;
+};
+
+template <>
+struct value_type<float> {
+	static constexpr bool supported = true;
+	static constexpr u8_t id = KNOT_VALUE_TYPE_FLOAT;
+	typedef float type;
+};
+
+/* Typed fast paths */
+inline bool set(struct knot_proxy *proxy, bool value)
+{
+	return knot_proxy_value_set_bool(proxy, value);
+}
+
+inline bool set(struct knot_proxy *proxy, s32_t value)
+{
+	return knot_proxy_value_set_int(proxy, value);
+}
+
+inline bool set(struct knot_proxy *proxy, float value)
+{
+	return knot_proxy_value_set_float(proxy, value);
+}
+
+/*
+ * Type ID and unit pairs known to the wrappers, a subset of the table
+ * behind knot_schema_is_valid(). Add the pair here before declaring a
+ * new Unit alias.
+ */
+struct schema {
+	u16_t type_id;
+	u8_t unit;
+};
+
+constexpr schema schemas[] = {
+	{ KNOT_TYPE_ID_SWITCH,		KNOT_UNIT_NOT_APPLICABLE },
+	{ KNOT_TYPE_ID_TEMPERATURE,	KNOT_UNIT_TEMPERATURE_C },
+	{ KNOT_TYPE_ID_VOLUME,		KNOT_UNIT_VOLUME_L },
+	{ KNOT_TYPE_ID_ANGLE,		KNOT_UNIT_ANGLE_DEGREE },
+};
+
+constexpr bool schema_is_valid(u16_t type_id, u8_t unit, size_t i = 0)
+{
+	return i < ARRAY_SIZE(schemas) &&
+	       ((schemas[i].type_id == type_id && schemas[i].unit == unit) ||
+		schema_is_valid(type_id, unit, i + 1));
+}
+
+constexpr bool type_id_is_logic(u16_t type_id)
+{
+	return type_id >= KNOT_TYPE_ID_LOGIC_MIN &&
+	       type_id <= KNOT_TYPE_ID_LOGIC_MAX;
+}
+
+} /* namespace detail */
+
+/*
+ * Type ID and unit pair. Logic types (switch, presence...) only take bool
+ * values and no unit, measurements take int or float.
+ */
+template <u16_t TypeId, u8_t UnitId>
+struct Unit {
+	static_assert(detail::schema_is_valid(TypeId, UnitId),
+		      "Unit not valid for this type ID");
+	static_assert(!detail::type_id_is_logic(TypeId) ||
+		      UnitId == KNOT_UNIT_NOT_APPLICABLE,
+		      "Logic type IDs take no unit");
+
+	static constexpr u16_t type_id = TypeId;
+	static constexpr u8_t unit = UnitId;
+	static constexpr bool logic = detail::type_id_is_logic(TypeId);
+
+	template <typename T>
+	static constexpr bool accepts()
+	{
+		return logic ?
+		       detail::value_type<T>::id == KNOT_VALUE_TYPE_BOOL :
+		       (detail::value_type<T>::id == KNOT_VALUE_TYPE_INT ||
+			detail::value_type<T>::id == KNOT_VALUE_TYPE_FLOAT);
+	}
+};
+
+using Switch = Unit<KNOT_TYPE_ID_SWITCH, KNOT_UNIT_NOT_APPLICABLE>;
+using Celsius = Unit<KNOT_TYPE_ID_TEMPERATURE, KNOT_UNIT_TEMPERATURE_C>;
+using Liter = Unit<KNOT_TYPE_ID_VOLUME, KNOT_UNIT_VOLUME_L>;
+using Degree = Unit<KNOT_TYPE_ID_ANGLE, KNOT_UNIT_ANGLE_DEGREE>;
+
+template <typename T, typename U>
+class Proxy {
+	static_assert(detail::value_type<T>::supported,
+		      "Proxy value must be bool, 32 bits int or float");
+	static_assert(U::template accepts<T>(),
+		      "Value type not allowed for this type ID and unit");
+
+public:
+	constexpr Proxy() : proxy(nullptr) {}
+
+	/* Wrap proxy received on callbacks */
+	explicit constexpr Proxy(struct knot_proxy *p) : proxy(p) {}
+
+	/* Register at setup() */
+	bool attach(u8_t id, const char *name,
+		    knot_callback_t changed_cb = nullptr,
+		    knot_callback_t poll_cb = nullptr)
+	{
+		proxy = knot_proxy_register(id, name, U::type_id,
+					    detail::value_type<T>::id,
+					    U::unit, changed_cb, poll_cb);
+
+		return proxy != nullptr;
+	}
+
+	bool set(T value)
+	{
+		return detail::set(proxy,
+			static_cast<typename detail::value_type<T>::type>(value));
+	}
+
+	bool get(T &value) const
+	{
+		return knot_proxy_value_get_basic(proxy, &value);
+	}
+
+	u8_t id() const
+	{
+		return knot_proxy_get_id(proxy);
+	}
+
+	struct knot_proxy *raw() const
+	{
+		return proxy;
+	}
+
+private:
+	struct knot_proxy *proxy;
+};
+
+} /* namespace knot */
+
+#endif /* KNOT_HPP */
@@ -19,23 +19,31 @@
 	#include <settings/settings_ot.h>
 #endif
 
+#include "ring.h"
 #include "proto.h"
 #include "net.h"
 #include "storage.h"
+#include "boot_time.h"
 
 LOG_MODULE_REGISTER(knot, CONFIG_KNOT_LOG_LEVEL);
-K_PIPE_DEFINE(p2n_pipe, 128, 4);
-K_PIPE_DEFINE(n2p_pipe, 128, 4);
+static struct ring p2n_ring;
+static struct ring n2p_ring;
 static struct k_sem quit_lock;
 
 void main(void)
 {
 	int ret;
 
+	boot_time_init();
+
 	LOG_DBG("*** Welcome to KNoT! %s\n", CONFIG_ARCH);
 
 	k_sem_init(&quit_lock, 0, UINT_MAX);
 
+	/* PROTO to NET and NET to PROTO messages */
+	ring_init(&p2n_ring);
+	ring_init(&n2p_ring);
+
 	/* Guarantees NET and PROTO threads will be created */
 	k_sched_lock();
 
@@ -60,23 +68,24 @@ void main(void)
 		if (ret)
 			LOG_ERR("Settings load failed (err %d)", ret);
 	#endif
+	boot_time_mark(BOOT_TIME_SETTINGS);
 
 	/*
 	 * KNoT state thread: manage device registration, detects
 	 * sensor data changes acting like a proxy forwarding data
 	 * from sensors to network layer (and oposite). Proto is
-	 * consumer of ipdu fifo and producer of opdu.
+	 * consumer of ipdu ring and producer of opdu.
 	 */
-	if (proto_start(&p2n_pipe, &n2p_pipe) < 0)
+	if (proto_start(&p2n_ring, &n2p_ring) < 0)
 		return;
 
 	/*
 	 * Network thread: manage traffic from TCP or non-ip wireless
 	 * technologies. Each technology(thread) is responsible for
 	 * managing incoming and outgoing data. Net is consumer of
-	 * opdu fifo and producer of ipdu.
+	 * opdu ring and producer of ipdu.
 	 */
-	if (net_start(&p2n_pipe, &n2p_pipe) < 0)
+	if (net_start(&p2n_ring, &n2p_ring) < 0)
 		return;
 
 	/* Allows NET and PROTO thread scheduling */
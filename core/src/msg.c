@@ -73,3 +73,17 @@ size_t msg_create_data(knot_msg *msg, u8_t id,
 
 	return (sizeof(msg->hdr) + msg->hdr.payload_len);
 }
+
+size_t msg_create_config(knot_msg *msg, u8_t id,
+			 const knot_config *config, bool resp)
+{
+	msg->hdr.type = resp ? KNOT_MSG_PUSH_CONFIG_RSP :
+			       KNOT_MSG_PUSH_CONFIG_REQ;
+	msg->config.sensor_id = id;
+
+	msg->hdr.payload_len = sizeof(msg->config.sensor_id) +
+				sizeof(msg->config.values);
+	memcpy(&msg->config.values, config, sizeof(*config));
+
+	return (sizeof(msg->hdr) + msg->hdr.payload_len);
+}
@@ -17,7 +17,10 @@
 #include <net/buf.h>
 #include <logging/log.h>
 
+#include "ring.h"
 #include "net.h"
+#include "proto.h"
+#include "boot_time.h"
 #if CONFIG_NET_UDP
 #include "udp6.h"
 #elif CONFIG_NET_TCP
@@ -29,38 +32,43 @@
 
 LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
+#if !CONFIG_KNOT_SINGLE_THREAD
 static struct k_thread rx_thread_data;
 static K_THREAD_STACK_DEFINE(rx_stack, 1024);
-static struct k_pipe *proto2net;
-static struct k_pipe *net2proto;
+#endif
+static struct ring *proto2net;
+static struct ring *net2proto;
 static bool connected;
+static bool tx_ready; /* Messages from PROTO can be sent right now */
+static s64_t retry_time; /* Uptime to retry connecting */
 
 K_SEM_DEFINE(conn_sem, 0, 1);
 
 #define CONN_RETRY_TIME K_SECONDS(5)
+#define OT_READY_POLL_TIME K_MSEC(100)
+#define RX_POLL_TIME K_MSEC(CONFIG_KNOT_NET_RX_POLL_TIME)
 
 static void close_cb(void)
 {
 	/* Flag as not connected */
 	k_sem_take(&conn_sem, K_NO_WAIT);
 	connected = false;
+	proto_wakeup();
 }
 
 static int recv_cb(void *buf, size_t len)
 {
 	int rc;
-	u8_t opdu[128];
 
-	if (len > sizeof(opdu)) {
+	if (len > RING_SLOT_SIZE) {
 		LOG_ERR("NET: SMALL PDU");
 		return -EMSGSIZE;
 	}
 
-	memcpy(opdu, buf, len);
 	/* Sending recv data to PROTO thread */
-	rc = k_pipe_put(net2proto, opdu, len, &len, len, K_NO_WAIT);
+	rc = ring_put(net2proto, buf, len);
 	if (rc)
-		LOG_ERR("Pipe write failed. Err: %d", rc);
+		LOG_ERR("Ring write failed. Err: %d", rc);
 
 	return rc;
 }
@@ -76,12 +84,6 @@ static int connection_start(void)
 {
 	int ret;
 
-	LOG_DBG("Waiting for OpenThread to be ready...");
-	#if CONFIG_SETTINGS_OT
-		while (ot_config_is_ready() == false)
-			k_sleep(100);
-	#endif
-
 	#if CONFIG_NET_UDP
 		ret = udp6_start(recv_cb, close_cb);
 		if (ret < 0) {
@@ -101,15 +103,15 @@ static int connection_start(void)
 
 	connected = true;
 	k_sem_give(&conn_sem);
+	proto_wakeup();
+	boot_time_mark(BOOT_TIME_CONNECTED);
 
 done:
 	return ret;
 }
 
-static void net_thread(void)
+int net_init(void)
 {
-	u8_t ipdu[128];
-	size_t ilen;
 	int ret;
 
 	/* Load and set OpenThread credentials from settings */
@@ -118,34 +120,36 @@ static void net_thread(void)
 		if (ret) {
 			LOG_ERR("Failed to init OT handler. \
 			Aborting net thread");
-			return;
+			return ret;
 		}
 
 		ret = ot_config_load();
 		if (ret) {
 			LOG_ERR("Failed to load OT credentials. \
 			Aborting net thread");
-			return;
+			return ret;
 		}
 
 		ret = ot_config_stop();
 		if (ret) {
 			LOG_ERR("Failed to stop OT. Aborting net thread");
-			return;
+			return ret;
 		}
 
 		ret = ot_config_set();
 		if (ret) {
 			LOG_ERR("Failed to set OT credentials. \
 			Aborting net thread");
-			return;
+			return ret;
 		}
 
 		ret = ot_config_start();
 		if (ret) {
 			LOG_ERR("Failed to start OT. Aborting net thread");
-			return;
+			return ret;
 		}
+
+		LOG_DBG("Waiting for OpenThread to be ready...");
 	#endif
 
 	#if CONFIG_NET_UDP
@@ -153,64 +157,117 @@ static void net_thread(void)
 		ret = udp6_init();
 		if (ret) {
 			LOG_ERR("Failed to init UDP handler. Aborting net thread");
-			return;
+			return ret;
 		}
 	#elif CONFIG_NET_TCP
 		/* Start TCP layer */
 		ret = tcp6_init();
 		if (ret) {
 			LOG_ERR("Failed to init TCP handler. Aborting net thread");
-			return;
+			return ret;
 		}
 	#endif
 
-	memset(ipdu, 0, sizeof(ipdu));
-	connection_start();
+	retry_time = 0;
+	boot_time_mark(BOOT_TIME_NET_INIT);
 
-	while (1) {
-		if (!connected) {
-			ret = connection_start();
-			if (ret) {
-				/* Wait before retrying connecting */
-				LOG_ERR("Waiting to retry to connecting...");
-				k_sleep(CONN_RETRY_TIME);
-				goto done;
-			}
-		}
-		/* Look for incoming messages */
-		#if CONFIG_NET_UDP
-			udp6_event_poll();
-		#elif CONFIG_NET_TCP
-			tcp6_event_poll();
-		#endif
+	return 0;
+}
 
-		ilen = 0;
-		/* Reading data from PROTO thread */
-		ret = k_pipe_get(proto2net, ipdu, sizeof(ipdu),
-				 &ilen, 0U, K_NO_WAIT);
-		if (ret != 0) {
-			LOG_ERR("Pipe read failed");
-			goto done;
-		}
+/*
+ * Run a single NET iteration without blocking. Returns the time in ms the
+ * caller may sleep before calling it again, or 0 to keep polling. While
+ * ready to send, sleeping ends early on messages from PROTO.
+ */
+s32_t net_poll(void)
+{
+	u8_t ipdu[128];
+	size_t ilen;
+	s64_t now;
+	int ret;
 
-		/* No message to send */
-		if (ilen == 0)
-			goto done;
+	tx_ready = false;
 
-		/* Send message */
-		#if CONFIG_NET_UDP
-			ret = udp6_send(ipdu, ilen);
-		#elif CONFIG_NET_TCP
-			ret = tcp6_send(ipdu, ilen);
+	if (!connected) {
+		#if CONFIG_SETTINGS_OT
+			if (ot_config_is_ready() == false)
+				return OT_READY_POLL_TIME;
 		#endif
+		boot_time_mark(BOOT_TIME_NET_READY);
+
+		/* Wait before retrying connecting */
+		now = k_uptime_get();
+		if (now < retry_time)
+			return retry_time - now;
+
+		ret = connection_start();
+		if (ret) {
+			LOG_ERR("Waiting to retry to connecting...");
+			retry_time = k_uptime_get() + CONN_RETRY_TIME;
+			return CONN_RETRY_TIME;
+		}
+	}
 
-		if (ret <= 0)
+	/* Look for incoming messages */
+	#if CONFIG_NET_UDP
+		udp6_event_poll();
+	#elif CONFIG_NET_TCP
+		tcp6_event_poll();
+
+		/* Keep messages on ring until last one is fully sent */
+		ret = tcp6_flush();
+		if (ret < 0)
 			LOG_ERR("Msg send fail (%d)", ret);
-		else
-			LOG_DBG("Sent %d bytes", ret);
+		else if (ret > 0)
+			return RX_POLL_TIME;
+	#endif
 
-done:
-		k_yield();
+	tx_ready = true;
+
+	/* Reading data from PROTO thread */
+	ret = ring_get(proto2net, ipdu, sizeof(ipdu), K_NO_WAIT);
+	if (ret < 0) {
+		LOG_ERR("Ring read failed");
+		return 0;
+	}
+	ilen = ret;
+
+	/* No message to send: socket is checked again after a while */
+	if (ilen == 0)
+		return RX_POLL_TIME;
+
+	/* Send message */
+	#if CONFIG_NET_UDP
+		ret = udp6_send(ipdu, ilen);
+	#elif CONFIG_NET_TCP
+		ret = tcp6_send(ipdu, ilen);
+	#endif
+
+	if (ret <= 0)
+		LOG_ERR("Msg send fail (%d)", ret);
+	else
+		LOG_DBG("Sent %d bytes", ret);
+
+	return 0;
+}
+
+#if !CONFIG_KNOT_SINGLE_THREAD
+static void net_thread(void)
+{
+	s32_t wait;
+
+	if (net_init())
+		return;
+
+	/* Socket is checked when the wait ends. Messages to send end it early */
+	while (1) {
+		wait = net_poll();
+		if (wait == 0)
+			k_yield();
+		else if (tx_ready)
+			ring_wait(proto2net, wait);
+		else
+			k_sleep(wait);
 	}
 
 	#if CONFIG_NET_UDP
@@ -219,8 +276,9 @@ done:
 		tcp6_stop();
 	#endif
 }
+#endif
 
-int net_start(struct k_pipe *p2n, struct k_pipe *n2p)
+int net_start(struct ring *p2n, struct ring *n2p)
 {
 	LOG_DBG("NET: Start");
 
@@ -228,10 +286,13 @@ int net_start(struct k_pipe *p2n, struct k_pipe *n2p)
 	net2proto = n2p;
 	connected = false;
 
+	/* Otherwise polled from PROTO thread event loop */
+#if !CONFIG_KNOT_SINGLE_THREAD
 	k_thread_create(&rx_thread_data, rx_stack,
 			K_THREAD_STACK_SIZEOF(rx_stack),
 			(k_thread_entry_t) net_thread,
 			NULL, NULL, NULL, K_PRIO_PREEMPT(15), 0, K_NO_WAIT);
+#endif
 
 	return 0;
 }
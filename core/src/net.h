@@ -9,5 +9,8 @@
 typedef int (*net_recv_t) (void *buf, size_t len);
 typedef void (*net_close_t) (void);
 
-int net_start(struct k_pipe *p2n, struct k_pipe *n2p);
+int net_start(struct ring *p2n, struct ring *n2p);
 void net_stop(void);
+
+int net_init(void);
+s32_t net_poll(void);
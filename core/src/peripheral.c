@@ -32,6 +32,8 @@ LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 #include <gpio.h>
 
 #include "peripheral.h"
+#include "ring.h"
+#include "proto.h"
 
 static struct device *rst_gpio;
 static struct device *status_gpio;
@@ -50,6 +52,7 @@ static s64_t last_toggle_time;
 static void set_reset(struct k_timer *timer_id)
 {
 	rst_flag = true;
+	proto_wakeup();
 }
 
 static void rst_btn_edge(struct device *rst_gpio,
@@ -167,4 +170,18 @@ bool peripheral_flag_status(void)
 	return false;
 }
 
+s32_t peripheral_status_wait(void)
+{
+	s64_t elapsed;
+
+	if (toggle_led_period < 0)
+		return K_FOREVER;
+
+	elapsed = k_uptime_get() - last_toggle_time;
+	if (elapsed >= toggle_led_period)
+		return K_NO_WAIT;
+
+	return (s32_t) (toggle_led_period - elapsed);
+}
+
 #endif
@@ -28,3 +28,6 @@ bool peripheral_get_reset(void);
 void peripheral_set_status_period(s64_t status);
 
 bool peripheral_flag_status(void);
+
+/* Time in ms until next status led toggle. K_FOREVER if not toggling */
+s32_t peripheral_status_wait(void);
@@ -12,7 +12,8 @@
  */
 
 
-#if (!defined(CONFIG_X86) && !defined(CONFIG_CPU_CORTEX_M4))
+#if (!defined(CONFIG_X86) && !defined(CONFIG_CPU_CORTEX_M4) && \
+     !CONFIG_KNOT_FLOAT_FIXED)
 	#warning "Floating point services are currently available only for boards \
 			based on the ARM Cortex-M4 or the Intel x86 architectures."
 #endif
@@ -23,21 +24,120 @@
 #include <logging/log.h>
 #include <misc/reboot.h>
 
+#include <knot/knot_protocol.h>
 #include "knot.h"
 #include "sm.h"
+#include "ring.h"
 #include "proto.h"
+#include "net.h"
+#include "proxy.h"
 #include "peripheral.h"
 #include "clear.h"
 
 LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
+#if CONFIG_KNOT_SINGLE_THREAD
+#define PROTO_STACK_SIZE	CONFIG_KNOT_SINGLE_THREAD_STACK_SIZE
+#else
+#define PROTO_STACK_SIZE	1024
+#endif
+
+#if CONFIG_KNOT_FLOAT_FIXED
+#define PROTO_THREAD_OPTIONS	0 /* No float math: skip FPU context */
+#else
+#define PROTO_THREAD_OPTIONS	K_FP_REGS
+#endif
+
 static struct k_thread rx_thread_data;
-static K_THREAD_STACK_DEFINE(rx_stack, 1024);
-static struct k_pipe *proto2net;
-static struct k_pipe *net2proto;
+static K_THREAD_STACK_DEFINE(rx_stack, PROTO_STACK_SIZE);
+static struct ring *proto2net;
+static struct ring *net2proto;
+/* May be raised from ISRs before proto_start() */
+static struct k_poll_signal wakeup_signal =
+	K_POLL_SIGNAL_INITIALIZER(wakeup_signal);
 
 extern struct k_sem conn_sem;
 
+#if !CONFIG_KNOT_LOOP_EVERY_PASS
+static atomic_t loop_wakeup = ATOMIC_INIT(1); /* First run after setup() */
+static u32_t loop_period; /* ms. 0: on wakeup only */
+static u32_t loop_last;
+
+void knot_app_set_loop_period(u32_t period)
+{
+	loop_period = period;
+}
+
+void knot_app_wakeup(void)
+{
+	atomic_set(&loop_wakeup, 1);
+	proto_wakeup();
+}
+
+/* Check if app loop() must run on this iteration */
+static bool loop_due(void)
+{
+	u32_t current_time;
+
+	if (atomic_set(&loop_wakeup, 0))
+		return true;
+
+	if (loop_period == 0)
+		return false;
+
+	current_time = k_uptime_get_32();
+	if (current_time - loop_last < loop_period)
+		return false;
+
+	loop_last = current_time;
+	return true;
+}
+
+/* Time in ms until loop() is due. K_FOREVER: on wakeup only */
+static s32_t loop_wait_time(void)
+{
+	u32_t elapsed;
+
+	if (loop_period == 0)
+		return K_FOREVER;
+
+	elapsed = k_uptime_get_32() - loop_last;
+
+	return (elapsed < loop_period ? loop_period - elapsed : K_NO_WAIT);
+}
+#else
+void knot_app_set_loop_period(u32_t period)
+{
+}
+
+void knot_app_wakeup(void)
+{
+}
+
+static inline bool loop_due(void)
+{
+	return true;
+}
+
+/* loop() expects to be called all the time */
+static inline s32_t loop_wait_time(void)
+{
+	return K_NO_WAIT;
+}
+#endif
+
+/* Shortest of two timeouts. K_FOREVER is the longest */
+static s32_t wait_min(s32_t a, s32_t b)
+{
+	if (a == K_FOREVER)
+		return b;
+
+	if (b == K_FOREVER)
+		return a;
+
+	return MIN(a, b);
+}
+
 /*
  * Handle connection and disconnection events. Return true if connected.
  */
@@ -65,7 +165,11 @@ done:
 	return connected;
 }
 
-static void proto_thread(void)
+/*
+ * Run a single PROTO iteration without blocking. Return time in ms until
+ * the next one is due if nothing wakes PROTO up before.
+ */
+static s32_t proto_poll(void)
 {
 	/* Considering KNOT Max MTU 128 */
 	u8_t ipdu[128];
@@ -74,6 +178,85 @@ static void proto_thread(void)
 	size_t ilen;
 	int ret;
 	bool reset;
+	s32_t wait = K_FOREVER;
+
+	/* Calling KNoT app: loop() */
+	if (loop_due())
+		loop();
+
+	/* Ignore net and SM if disconnected */
+	if (check_connection() == false) {
+		peripheral_set_status_period(STATUS_DISCONN_PERIOD);
+		goto done;
+	}
+
+	memset(&ipdu, 0, sizeof(ipdu));
+	/* Reading data from NET thread */
+	ret = ring_get(net2proto, ipdu, sizeof(ipdu), K_NO_WAIT);
+	ilen = (ret > 0 ? ret : 0);
+
+	olen = sm_run(ipdu, ilen, opdu, sizeof(opdu));
+
+	/* Sending data to NET thread */
+	if (olen != 0) {
+		ret = ring_put(proto2net, opdu, olen);
+		if (ret)
+			LOG_ERR("Ring write failed. Err: %d", ret);
+	}
+
+	wait = sm_wait_time();
+
+done:
+	peripheral_flag_status();
+	wait = wait_min(wait, peripheral_status_wait());
+
+	/* Handle reset flag */
+	reset = peripheral_get_reset();
+	if (reset) {
+		/* Credentials are dropped along with the other settings */
+		LOG_INF("Reseting system...");
+		#if !CONFIG_BOARD_QEMU_X86
+		clear_factory();
+			sys_reboot(SYS_REBOOT_WARM);
+		#endif
+	}
+
+	return wait_min(wait, loop_wait_time());
+}
+
+void proto_wakeup(void)
+{
+	k_poll_signal_raise(&wakeup_signal, 0);
+}
+
+/* Sleep up to 'timeout' ms or until a message or a wakeup arrives */
+static void proto_wait(s32_t timeout)
+{
+	struct k_poll_event events[2];
+
+	if (timeout == K_NO_WAIT) {
+		k_yield();
+		return;
+	}
+
+	k_poll_event_init(&events[0], K_POLL_TYPE_SIGNAL,
+			  K_POLL_MODE_NOTIFY_ONLY, &wakeup_signal);
+	if (ring_poll_prepare(net2proto, &events[1]) == false)
+		return;
+
+	k_poll(events, ARRAY_SIZE(events), timeout);
+
+	/* Wakeups raised from now on are seen by next wait */
+	k_poll_signal_reset(&wakeup_signal);
+}
+
+static void proto_thread(void)
+{
+	s32_t wait;
+#if CONFIG_KNOT_SINGLE_THREAD
+	s32_t net_wait;
+	bool net_ready;
+#endif
 
 	/* Initializing KNoT peripherals control */
 	peripheral_init();
@@ -85,50 +268,34 @@ static void proto_thread(void)
 	/* Calling KNoT app: setup() */
 	setup();
 
-	while (1) {
-		/* Calling KNoT app: loop() */
-		loop();
-
-		/* Ignore net and SM if disconnected */
-		if (check_connection() == false) {
-			peripheral_set_status_period(STATUS_DISCONN_PERIOD);
-			goto done;
-		}
+	/* Config pushed from cloud overrides app defaults */
+	if (proxy_load_config() == 0)
+		LOG_INF("Stored proxies config loaded");
 
-		ilen = 0;
-		memset(&ipdu, 0, sizeof(ipdu));
-		/* Reading data from NET thread */
-		ret = k_pipe_get(net2proto, ipdu, sizeof(ipdu),
-				 &ilen, 0U, K_NO_WAIT);
-
-		olen = sm_run(ipdu, ilen, opdu, sizeof(opdu));
+#if CONFIG_KNOT_SINGLE_THREAD
+	/* NET runs from this same event loop */
+	net_ready = (net_init() == 0);
+	if (!net_ready)
+		LOG_ERR("NET init failed. Running offline");
+#endif
 
-		/* Sending data to NET thread */
-		if (olen != 0)
-			k_pipe_put(proto2net, opdu, olen,
-				   &olen, olen, K_NO_WAIT);
+	while (1) {
+		wait = proto_poll();
 
-done:
-		peripheral_flag_status();
-
-		/* Handle reset flag */
-		reset = peripheral_get_reset();
-		if (reset) {
-			/* TODO: Unregister before reseting */
-			LOG_INF("Reseting system...");
-			#if !CONFIG_BOARD_QEMU_X86
-			clear_factory();
-				sys_reboot(SYS_REBOOT_WARM);
-			#endif
+#if CONFIG_KNOT_SINGLE_THREAD
+		/* Socket can't be waited on: check it when net_poll() asks */
+		if (net_ready) {
+			net_wait = net_poll();
+			wait = wait_min(wait, net_wait);
 		}
-
-		k_yield();
+#endif
+		proto_wait(wait);
 	}
 
 	sm_stop();
 }
 
-int proto_start(struct k_pipe *p2n, struct k_pipe *n2p)
+int proto_start(struct ring *p2n, struct ring *n2p)
 {
 	LOG_DBG("PROTO: Start");
 
@@ -138,7 +305,7 @@ int proto_start(struct k_pipe *p2n, struct k_pipe *n2p)
 			K_THREAD_STACK_SIZEOF(rx_stack),
 			(k_thread_entry_t) proto_thread,
 			NULL, NULL, NULL, K_PRIO_PREEMPT(15),
-			K_FP_REGS, K_NO_WAIT);
+			PROTO_THREAD_OPTIONS, K_NO_WAIT);
 
 	return 0;
 }
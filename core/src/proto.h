@@ -6,6 +6,8 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-int proto_start(struct k_pipe *p2n, struct k_pipe *n2p);
+int proto_start(struct ring *p2n, struct ring *n2p);
 
 void proto_stop(void);
+
+void proto_wakeup(void);
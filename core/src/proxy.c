@@ -15,11 +15,17 @@
 #include <knot/knot_types.h>
 #include "msg.h"
 #include "proxy.h"
+#include "storage.h"
+#include "ring.h"
+#include "proto.h"
 #include "knot.h"
 
 LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
 #define MIN(a, b)         (((a) < (b)) ? (a) : (b))
+#ifndef MAX
+#define MAX(a, b)         (((a) > (b)) ? (a) : (b))
+#endif
 
 #define check_bool_change(proxy, bval) \
 	(KNOT_EVT_FLAG_CHANGE & proxy->config.event_flags \
@@ -49,6 +55,20 @@ LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 	(KNOT_EVT_FLAG_LOWER_THRESHOLD & proxy->config.event_flags \
 	&& fval < proxy->config.lower_limit.val_f)
 
+#if CONFIG_KNOT_FLOAT_FIXED
+#define check_q16_change(proxy, q16val)	\
+	(KNOT_EVT_FLAG_CHANGE & proxy->config.event_flags \
+	&& q16val != proxy->value_q16)
+
+#define check_q16_upper_threshold(proxy, q16val)	\
+	(KNOT_EVT_FLAG_UPPER_THRESHOLD & proxy->config.event_flags \
+	&& q16val > proxy->upper_q16)
+
+#define check_q16_lower_threshold(proxy, q16val)	\
+	(KNOT_EVT_FLAG_LOWER_THRESHOLD & proxy->config.event_flags \
+	&& q16val < proxy->lower_q16)
+#endif
+
 #define check_raw_change(proxy, rawval, rawlen)	\
 	(KNOT_EVT_FLAG_CHANGE & proxy->config.event_flags \
 	&& ( proxy->rlen != rawlen \
@@ -78,21 +98,314 @@ static struct knot_proxy {
 
 	/* Time values */
 	u32_t			last_timeout;
+	u32_t			sample_period; /* Poll period in ms */
+	u32_t			last_sample;
 
 	knot_callback_t		poll_cb; /* Poll for local changes */
 	knot_callback_t		changed_cb; /* Report new value to user app */
+
+	atomic_t		flags; /* Dispatch control. See PROXY_FLAG_* */
+	knot_value_type		staged; /* Sample completed asynchronously */
+	atomic_t		pending_count; /* Counted from ISR, not read */
+	s32_t			count; /* Counter proxies total */
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	/* Float value and limits as Q16.16. 'value' keeps wire format */
+	s32_t			value_q16;
+	s32_t			upper_q16;
+	s32_t			lower_q16;
+#endif
+
+#if CONFIG_KNOT_PROXY_HISTORY_POOL > 0
+	struct {
+		u16_t		start; /* First sample slot on pool */
+		u8_t		size; /* Slots taken. 0: disabled */
+		u8_t		head; /* Next slot to write */
+		u8_t		count; /* Samples kept */
+		union {
+			s64_t	sum_i;
+			float	sum_f;
+		};		/* Sum of kept samples */
+	} history;
+#endif
 } proxy_pool[CONFIG_KNOT_THING_DATA_MAX];
 
+#if CONFIG_KNOT_PROXY_HISTORY_POOL > 0
+/* Samples of every proxy history, allocated at enable */
+static union history_sample {
+	bool			val_b;
+	s32_t			val_i;
+	float			val_f;
+} history_pool[CONFIG_KNOT_PROXY_HISTORY_POOL];
+
+static u16_t history_used;
+#endif
+
+/* Proxy flags */
+#define PROXY_FLAG_BUSY		0 /* Callback queued or running */
+#define PROXY_FLAG_POLLED	1 /* Poll finished, result not read yet */
+#define PROXY_FLAG_STAGED	2 /* Async sample pending evaluation */
+#define PROXY_FLAG_PUBLISH	3 /* Staged sample must be sent */
+#define PROXY_FLAG_COUNTER	4 /* Value owned by SDK counter */
+#define PROXY_FLAG_SAMPLE	5 /* App requested poll out of period */
+
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+/* Callbacks work item */
+struct cb_work {
+	u8_t			id;
+	bool			poll; /* Poll or changed callback */
+};
+
+/* At most one pending callback per proxy */
+K_MSGQ_DEFINE(proxy_cb_msgq, sizeof(struct cb_work),
+	      CONFIG_KNOT_THING_DATA_MAX, 4);
+
+#if CONFIG_KNOT_FLOAT_FIXED
+#define CB_THREAD_OPTIONS	0 /* As PROTO: callbacks use no float math */
+#else
+#define CB_THREAD_OPTIONS	K_FP_REGS
+#endif
+
+static struct k_thread cb_thread_data;
+static K_THREAD_STACK_DEFINE(cb_stack, CONFIG_KNOT_PROXY_CB_STACK_SIZE);
+static bool cb_thread_started;
+
+/*
+ * Values are set by callbacks thread and read by PROTO. Recursive, so
+ * setters called while evaluating a staged sample take it again.
+ */
+K_MUTEX_DEFINE(proxy_value_lock);
+
+/* Copy of value returned by proxy_read() */
+static knot_value_type read_value;
+
+static inline void value_lock(void)
+{
+	k_mutex_lock(&proxy_value_lock, K_FOREVER);
+}
+
+static inline void value_unlock(void)
+{
+	k_mutex_unlock(&proxy_value_lock);
+}
+#else
+static inline void value_lock(void)
+{
+}
+
+static inline void value_unlock(void)
+{
+}
+#endif
+
+#if CONFIG_KNOT_PROXY_CB_MAX_TIME > 0
+/* Callbacks run one at a time, either on PROTO or on callbacks thread */
+static const char *cb_running;
+
+/* Report callbacks that never return while they are still running */
+static void cb_expired(struct k_timer *timer)
+{
+	struct knot_proxy *proxy = k_timer_user_data_get(timer);
+
+	LOG_WRN("%s callback for ID %d still running after %d ms",
+		cb_running, proxy->id, CONFIG_KNOT_PROXY_CB_MAX_TIME);
+}
+
+K_TIMER_DEFINE(proxy_cb_timer, cb_expired, NULL);
+#endif
+
 static u8_t last_id = 0xff;
+static u8_t period_scale = 1; /* Report periods multiplier */
+
+/* Config record as kept on NVM. Limits are only stored for int or float */
+struct config_record {
+	u8_t			id; /* 0xff: not set */
+	u8_t			event_flags;
+	u16_t			time_sec;
+	s32_t			lower_limit;
+	s32_t			upper_limit;
+} __packed;
+
+BUILD_ASSERT(sizeof(struct config_record) == STORAGE_CONFIG_RECORD_LEN);
+
+/*
+ * IEEE 754 single precision <-> Q16.16 with integer operations only.
+ * Out of range values saturate, subnormals are taken as zero.
+ */
+static u32_t q16_to_float_bits(s32_t q16)
+{
+	u32_t sign = 0;
+	u32_t mag;
+	int msb;
+
+	if (q16 == 0)
+		return 0;
+
+	if (q16 < 0) {
+		sign = 0x80000000;
+		mag = -(u32_t) q16;
+	} else {
+		mag = q16;
+	}
+
+	/* Normalize leading one to bit 23. Extra low bits are truncated */
+	msb = 31 - __builtin_clz(mag);
+	if (msb > 23)
+		mag >>= msb - 23;
+	else
+		mag <<= 23 - msb;
+
+	return sign | ((u32_t) (msb - 16 + 127) << 23) | (mag & 0x7fffff);
+}
+
+#if CONFIG_KNOT_FLOAT_FIXED
+static s32_t float_bits_to_q16(u32_t bits)
+{
+	u32_t mant;
+	s64_t val;
+	int shift;
+
+	if (((bits >> 23) & 0xff) == 0)
+		return 0;
+
+	mant = (bits & 0x7fffff) | 0x800000;
+
+	/* value = mant * 2^(exp - 150); Q16.16 = value * 2^16 */
+	shift = (int) ((bits >> 23) & 0xff) - 134;
+	if (shift > 7)
+		val = INT_MAX;
+	else if (shift >= 0)
+		val = MIN((s64_t) mant << shift, INT_MAX);
+	else if (shift > -32)
+		val = mant >> -shift;
+	else
+		val = 0;
+
+	return (bits & 0x80000000) ? (s32_t) -val : (s32_t) val;
+}
+
+/* Limits given as double. Subnormals are taken as zero */
+static u32_t double_bits_to_float_bits(u64_t bits)
+{
+	u32_t sign = (bits >> 32) & 0x80000000;
+	int exp = (int) ((bits >> 52) & 0x7ff) - 1023 + 127;
+
+	if (exp <= 0)
+		return sign;
+
+	/* Too large for float: saturated as infinity */
+	if (exp >= 0xff)
+		return sign | 0x7f800000;
+
+	return sign | ((u32_t) exp << 23) | (u32_t) ((bits >> 29) & 0x7fffff);
+}
+
+#endif
+
+/* Float pointed by 'value' without loading it to FPU registers */
+static inline u32_t float_bits(const void *value)
+{
+	u32_t bits;
+
+	memcpy(&bits, value, sizeof(bits));
+
+	return bits;
+}
+
+/*
+ * Run app callback, logging if it takes longer than allowed. The timer
+ * reports callbacks that hang, which would never reach the check below.
+ */
+static void run_cb(struct knot_proxy *proxy, knot_callback_t cb,
+		   const char *cb_name)
+{
+#if CONFIG_KNOT_PROXY_CB_MAX_TIME > 0
+	u32_t start_time;
+	u32_t elapsed_time;
+
+	cb_running = cb_name;
+	k_timer_user_data_set(&proxy_cb_timer, proxy);
+	k_timer_start(&proxy_cb_timer,
+		      K_MSEC(CONFIG_KNOT_PROXY_CB_MAX_TIME), 0);
+
+	start_time = k_uptime_get_32();
+	cb(proxy);
+	elapsed_time = k_uptime_get_32() - start_time;
+
+	k_timer_stop(&proxy_cb_timer);
+
+	if (elapsed_time > CONFIG_KNOT_PROXY_CB_MAX_TIME)
+		LOG_WRN("%s callback for ID %d overran: %u ms",
+			cb_name, proxy->id, elapsed_time);
+#else
+	cb(proxy);
+#endif
+}
+
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+static void cb_thread(void)
+{
+	struct knot_proxy *proxy;
+	struct cb_work work;
+
+	while (1) {
+		k_msgq_get(&proxy_cb_msgq, &work, K_FOREVER);
+		proxy = &proxy_pool[work.id];
+
+		if (work.poll) {
+			run_cb(proxy, proxy->poll_cb, "Poll");
+			/* Signal SM result is ready */
+			atomic_set_bit(&proxy->flags, PROXY_FLAG_POLLED);
+		} else {
+			run_cb(proxy, proxy->changed_cb, "Changed");
+		}
+
+		atomic_clear_bit(&proxy->flags, PROXY_FLAG_BUSY);
+		proto_wakeup();
+	}
+}
+
+static void submit_cb(struct knot_proxy *proxy, bool poll)
+{
+	struct cb_work work = {
+		.id = proxy->id,
+		.poll = poll,
+	};
+
+	/* Never full: only one callback per proxy is queued */
+	if (k_msgq_put(&proxy_cb_msgq, &work, K_NO_WAIT)) {
+		LOG_ERR("Failed to queue callback for ID %d", proxy->id);
+		atomic_clear_bit(&proxy->flags, PROXY_FLAG_BUSY);
+	}
+}
+#endif
 
 void proxy_init(void)
 {
 	int i;
 
 	memset(proxy_pool, 0, sizeof(proxy_pool));
+#if CONFIG_KNOT_PROXY_HISTORY_POOL > 0
+	history_used = 0;
+#endif
 
 	for (i = 0; (i < sizeof(proxy_pool) / sizeof(struct knot_proxy)); i++)
 		proxy_pool[i].id = 0xff;
+
+	period_scale = 1;
+
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	if (cb_thread_started)
+		return;
+
+	/* Same priority as PROTO: both share CPU when yielding */
+	k_thread_create(&cb_thread_data, cb_stack,
+			K_THREAD_STACK_SIZEOF(cb_stack),
+			(k_thread_entry_t) cb_thread,
+			NULL, NULL, NULL, K_PRIO_PREEMPT(15),
+			CB_THREAD_OPTIONS, K_NO_WAIT);
+	cb_thread_started = true;
+#endif
 }
 
 void proxy_stop(void)
@@ -149,16 +462,80 @@ struct knot_proxy *knot_proxy_register(u8_t id, const char *name,
 	proxy->poll_cb = poll_cb;
 	proxy->changed_cb = changed_cb;
 
+	atomic_clear(&proxy->flags);
+	atomic_clear(&proxy->pending_count);
+	proxy->count = 0;
+
 	if (id > last_id || last_id == 0xff)
 		last_id = id;
 
 	return proxy;
 }
 
-bool knot_proxy_set_config(u8_t id, ...)
+static bool apply_config(struct knot_proxy *proxy, u8_t event_flags,
+			 u16_t timeout_sec,
+			 const knot_value_type *lower_limit,
+			 const knot_value_type *upper_limit)
 {
-	va_list event_args;
+	if (knot_config_is_valid(event_flags, proxy->schema.value_type,
+				 timeout_sec, lower_limit, upper_limit) != 0) {
+		LOG_ERR("Config for ID %d failed: "
+			"Invalid config values", proxy->id);
+		return false;
+	}
+
+	/* Set upper and lower limits */
+	if (event_flags & KNOT_EVT_FLAG_UPPER_THRESHOLD)
+		memcpy(&proxy->config.upper_limit,
+		       upper_limit, sizeof(*upper_limit));
 
+	if (event_flags & KNOT_EVT_FLAG_LOWER_THRESHOLD)
+		memcpy(&proxy->config.lower_limit,
+		       lower_limit, sizeof(*lower_limit));
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	if (proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT) {
+		proxy->upper_q16 = float_bits_to_q16(
+					proxy->config.upper_limit.val_i);
+		proxy->lower_q16 = float_bits_to_q16(
+					proxy->config.lower_limit.val_i);
+	}
+#endif
+
+	/* Set event flags and timeout */
+	proxy->config.event_flags = event_flags;
+	proxy->config.time_sec = timeout_sec;
+
+	return true;
+}
+
+/* Float limit given as double or as Q16.16 */
+static u32_t limit_float_bits(va_list *args, bool q16)
+{
+#if CONFIG_KNOT_FLOAT_FIXED
+	double value;
+	u64_t bits;
+#else
+	float value;
+#endif
+
+	if (q16)
+		return q16_to_float_bits(va_arg(*args, int));
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	value = va_arg(*args, double);
+	memcpy(&bits, &value, sizeof(bits));
+
+	return double_bits_to_float_bits(bits);
+#else
+	value = (float) va_arg(*args, double);
+
+	return float_bits(&value);
+#endif
+}
+
+static bool set_config(u8_t id, bool q16, va_list *event_args)
+{
 	struct knot_proxy *proxy;
 	u8_t event;
 	u8_t event_flags = KNOT_EVT_FLAG_NONE;
@@ -185,9 +562,8 @@ bool knot_proxy_set_config(u8_t id, ...)
 	}
 
 	/* Read arguments and set event_flags */
-	va_start(event_args, id);
 	do {
-		event = (u8_t) va_arg(event_args, int);
+		event = (u8_t) va_arg(*event_args, int);
 		switch(event) {
 		case KNOT_EVT_FLAG_NONE:
 			break;
@@ -195,58 +571,145 @@ bool knot_proxy_set_config(u8_t id, ...)
 			event_flags |= KNOT_EVT_FLAG_CHANGE;
 			break;
 		case KNOT_EVT_FLAG_TIME:
-			timeout_sec = (u16_t) va_arg(event_args, int);
+			timeout_sec = (u16_t) va_arg(*event_args, int);
 			event_flags |= KNOT_EVT_FLAG_TIME;
 			break;
 		case KNOT_EVT_FLAG_UPPER_THRESHOLD:
 			if(proxy->schema.value_type == KNOT_VALUE_TYPE_INT)
-				upper_limit.val_i = (s32_t) va_arg(event_args,
+				upper_limit.val_i = (s32_t) va_arg(*event_args,
 							 int);
 			if(proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT)
-				upper_limit.val_f = (float) va_arg(event_args,
-							 double);
+				upper_limit.val_i = limit_float_bits(event_args,
+								     q16);
 			event_flags |= KNOT_EVT_FLAG_UPPER_THRESHOLD;
 			break;
 		case KNOT_EVT_FLAG_LOWER_THRESHOLD:
 			if(proxy->schema.value_type == KNOT_VALUE_TYPE_INT)
-				lower_limit.val_i = (s32_t) va_arg(event_args,
+				lower_limit.val_i = (s32_t) va_arg(*event_args,
 							 int);
 			if(proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT)
-				lower_limit.val_f = (float) va_arg(event_args,
-							 double);
+				lower_limit.val_i = limit_float_bits(event_args,
+								     q16);
 			event_flags |= KNOT_EVT_FLAG_LOWER_THRESHOLD;
 			break;
 		default:
-			va_end(event_args);
 			LOG_ERR("Config for ID %d failed: "
 				"Invalid config flags", id);
 			return false;
 		}
 
 	} while(event);
+
+	return apply_config(proxy, event_flags, timeout_sec,
+			    &lower_limit, &upper_limit);
+}
+
+bool knot_proxy_set_config(u8_t id, ...)
+{
+	va_list event_args;
+	bool ret;
+
+	va_start(event_args, id);
+	ret = set_config(id, false, &event_args);
 	va_end(event_args);
 
-	if (knot_config_is_valid(event_flags, proxy->schema.value_type,
-				 timeout_sec, &lower_limit, &upper_limit) != 0) {
-		LOG_ERR("Config for ID %d failed: "
-			"Invalid config values", id);
-		return false;
+	return ret;
+}
+
+bool knot_proxy_set_config_q16(u8_t id, ...)
+{
+	va_list event_args;
+	bool ret;
+
+	va_start(event_args, id);
+	ret = set_config(id, true, &event_args);
+	va_end(event_args);
+
+	return ret;
+}
+
+s8_t proxy_set_config(u8_t id, const knot_config *config)
+{
+	struct knot_proxy *proxy;
+
+	if (id >= CONFIG_KNOT_THING_DATA_MAX)
+		return -EINVAL;
+
+	proxy = &proxy_pool[id];
+
+	if (proxy->id == 0xff)
+		return -EINVAL;
+
+	if (apply_config(proxy, config->event_flags, config->time_sec,
+			 &config->lower_limit, &config->upper_limit) == false)
+		return -EINVAL;
+
+	return 0;
+}
+
+int proxy_store_config(void)
+{
+	struct config_record records[CONFIG_KNOT_THING_DATA_MAX];
+	struct knot_proxy *proxy;
+	int i;
+	int rc;
+
+	memset(records, 0xff, sizeof(records));
+
+	for (i = 0; i < CONFIG_KNOT_THING_DATA_MAX; i++) {
+		proxy = &proxy_pool[i];
+		if (proxy->id == 0xff)
+			continue;
+
+		records[i].id = proxy->id;
+		records[i].event_flags = proxy->config.event_flags;
+		records[i].time_sec = proxy->config.time_sec;
+		records[i].lower_limit = proxy->config.lower_limit.val_i;
+		records[i].upper_limit = proxy->config.upper_limit.val_i;
 	}
 
-	/* Set upper and lower limits */
-	if (event_flags & KNOT_EVT_FLAG_UPPER_THRESHOLD)
-		memcpy(&proxy->config.upper_limit,
-		       &upper_limit, sizeof(upper_limit));
+	rc = storage_write(STORAGE_PROXY_CONFIG, records, sizeof(records));
+	if (rc != sizeof(records)) {
+		LOG_ERR("Failed to store proxies config");
+		return (rc < 0 ? rc : -EIO);
+	}
 
-	if (event_flags & KNOT_EVT_FLAG_LOWER_THRESHOLD)
-		memcpy(&proxy->config.lower_limit,
-		       &lower_limit, sizeof(lower_limit));
+	return 0;
+}
 
-	/* Set event flags and timeout */
-	proxy->config.event_flags = event_flags;
-	proxy->config.time_sec = timeout_sec;
+int proxy_load_config(void)
+{
+	struct config_record records[CONFIG_KNOT_THING_DATA_MAX];
+	knot_value_type lower_limit;
+	knot_value_type upper_limit;
+	struct knot_proxy *proxy;
+	int i;
+	int rc;
 
-	return true;
+	rc = storage_read(STORAGE_PROXY_CONFIG, records, sizeof(records));
+	if (rc != sizeof(records))
+		return -ENOENT;
+
+	for (i = 0; i < CONFIG_KNOT_THING_DATA_MAX; i++) {
+		proxy = &proxy_pool[i];
+
+		/* Ignore records of proxies no longer registered */
+		if (records[i].id != i || proxy->id != i)
+			continue;
+
+		/* Limits stored as 32 bits: val_i and val_f share memory */
+		memset(&lower_limit, 0, sizeof(lower_limit));
+		memset(&upper_limit, 0, sizeof(upper_limit));
+		lower_limit.val_i = records[i].lower_limit;
+		upper_limit.val_i = records[i].upper_limit;
+
+		if (apply_config(proxy, records[i].event_flags,
+				 records[i].time_sec,
+				 &lower_limit, &upper_limit) == false)
+			LOG_WRN("Ignoring stored config for ID %d", i);
+	}
+
+	return 0;
 }
 
 /* Proxy properties */
@@ -271,35 +734,206 @@ u8_t proxy_get_last_id(void)
 	return last_id;
 }
 
+void proxy_set_period_scale(u8_t scale)
+{
+	period_scale = (scale ? scale : 1);
+}
+
+/* Check if poll callback must run on this pass */
+static bool sample_due(struct knot_proxy *proxy)
+{
+	u32_t current_time;
+
+	/* Requested or pending values must be read now */
+	if (atomic_test_and_clear_bit(&proxy->flags, PROXY_FLAG_SAMPLE) ||
+	    proxy->send)
+		goto sample;
+
+	if (proxy->sample_period == 0)
+		return true;
+
+	if (proxy->sample_period == KNOT_SAMPLE_ON_DEMAND)
+		return false;
+
+	current_time = k_uptime_get_32();
+	if (current_time - proxy->last_sample < proxy->sample_period)
+		return false;
+
+sample:
+	proxy->last_sample = k_uptime_get_32();
+	return true;
+}
+
+/* Time in ms until the next periodic event of a counter proxy */
+static s32_t timeout_wait(struct knot_proxy *proxy)
+{
+	u32_t elapsed;
+	u32_t period;
+
+	if (!(KNOT_EVT_FLAG_TIME & proxy->config.event_flags))
+		return K_FOREVER;
+
+	period = proxy->config.time_sec * 1000U * period_scale;
+	elapsed = k_uptime_get_32() - proxy->last_timeout;
+
+	return (elapsed < period ? period - elapsed : K_NO_WAIT);
+}
+
+/*
+ * Time in ms until proxy_read() has work to do on any proxy. Samples
+ * staged from ISRs and callbacks finished call proto_wakeup() instead.
+ */
+s32_t proxy_wait_time(void)
+{
+	struct knot_proxy *proxy;
+	s32_t wait = K_FOREVER;
+	s32_t next;
+	u32_t elapsed;
+	int i;
+
+	if (last_id == 0xff)
+		return K_FOREVER;
+
+	for (i = 0; i <= last_id; i++) {
+		proxy = &proxy_pool[i];
+		if (proxy->id == 0xff)
+			continue;
+
+		/* Callbacks thread wakes PROTO when done */
+		if (atomic_test_bit(&proxy->flags, PROXY_FLAG_BUSY))
+			continue;
+
+		if (atomic_test_bit(&proxy->flags, PROXY_FLAG_POLLED) ||
+		    atomic_test_bit(&proxy->flags, PROXY_FLAG_STAGED) ||
+		    atomic_get(&proxy->pending_count) != 0)
+			return K_NO_WAIT;
+
+		if (atomic_test_bit(&proxy->flags, PROXY_FLAG_COUNTER)) {
+			next = timeout_wait(proxy);
+		} else if (proxy->poll_cb == NULL) {
+			continue;
+		} else if (atomic_test_bit(&proxy->flags, PROXY_FLAG_SAMPLE)) {
+			return K_NO_WAIT;
+		} else if (proxy->send || proxy->sample_period == 0) {
+			/* Polled on every pass */
+			next = K_MSEC(CONFIG_KNOT_PASS_PERIOD);
+		} else if (proxy->sample_period == KNOT_SAMPLE_ON_DEMAND) {
+			continue;
+		} else {
+			elapsed = k_uptime_get_32() - proxy->last_sample;
+			next = (elapsed < proxy->sample_period ?
+				proxy->sample_period - elapsed : K_NO_WAIT);
+		}
+
+		if (next != K_FOREVER && (wait == K_FOREVER || next < wait))
+			wait = next;
+	}
+
+	return wait;
+}
+
 /* Return knot_value_type* so it can be flagged as const  */
 const knot_value_type *proxy_read(u8_t id, u8_t *olen, bool wait_resp)
 {
+	const knot_value_type *value = NULL;
 	struct knot_proxy *proxy;
+	knot_value_type sample;
+	unsigned int key;
+	bool staged;
+	bool publish = false;
 
 	if (proxy_pool[id].id == 0xff)
 		return NULL;
 
 	proxy = &proxy_pool[id];
 
-	if (proxy->poll_cb == NULL)
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	/* Callback still running: check again next time */
+	if (atomic_test_bit(&proxy->flags, PROXY_FLAG_BUSY))
 		return NULL;
+#endif
+
+	/* Callbacks thread may set values of any proxy */
+	value_lock();
+
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	/* Poll finished: read its result */
+	if (atomic_test_and_clear_bit(&proxy->flags, PROXY_FLAG_POLLED))
+		goto done;
+#endif
+
+	/* Sample and its flags are staged together from ISRs */
+	key = irq_lock();
+	staged = atomic_test_and_clear_bit(&proxy->flags, PROXY_FLAG_STAGED);
+	if (staged) {
+		memcpy(&sample, &proxy->staged, sizeof(sample));
+		publish = atomic_test_and_clear_bit(&proxy->flags,
+						    PROXY_FLAG_PUBLISH);
+	}
+	irq_unlock(key);
+
+	/* Sample completed asynchronously: evaluate it as a new value */
+	if (staged) {
+		proxy->olen = 0;
+		proxy->wait_resp = wait_resp;
+		if (publish)
+			proxy->send = true;
+
+		knot_proxy_value_set_basic(proxy, &sample);
+		goto done;
+	}
+
+	/* Events counted on ISR: no edge is lost between reads */
+	if (atomic_test_bit(&proxy->flags, PROXY_FLAG_COUNTER)) {
+		proxy->count += atomic_set(&proxy->pending_count, 0);
+
+		proxy->olen = 0;
+		proxy->wait_resp = wait_resp;
+		knot_proxy_value_set_basic(proxy, &proxy->count);
+		goto done;
+	}
+
+	if (proxy->poll_cb == NULL)
+		goto unlock;
+
+	if (sample_due(proxy) == false)
+		goto unlock;
 
 	proxy->olen = 0;
 
 	/* Wait for response? */
 	proxy->wait_resp = wait_resp;
 
-	proxy->poll_cb(proxy);
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	atomic_set_bit(&proxy->flags, PROXY_FLAG_BUSY);
+	submit_cb(proxy, true);
 
+	goto unlock;
+#else
+	run_cb(proxy, proxy->poll_cb, "Poll");
+#endif
+
+done:
 	/*
 	 * Read callback may set new values. When a
 	 * new value is set "olen" field is set.
 	 */
 	if (proxy->olen <= 0)
-		return NULL;
+		goto unlock;
 
 	*olen = proxy->olen;
-	return &proxy->value;
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	/* Callbacks may set it again once unlocked */
+	memcpy(&read_value, &proxy->value, sizeof(read_value));
+	value = &read_value;
+#else
+	value = &proxy->value;
+#endif
+
+unlock:
+	value_unlock();
+
+	return value;
 }
 
 s8_t proxy_write(u8_t id, const knot_value_type *value, u8_t value_len)
@@ -317,6 +951,13 @@ s8_t proxy_write(u8_t id, const knot_value_type *value, u8_t value_len)
 	if (proxy->changed_cb == NULL)
 		return 0;
 
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	/* Don't touch value while app callback is using it */
+	if (atomic_test_and_set_bit(&proxy->flags, PROXY_FLAG_BUSY))
+		return -EBUSY;
+#endif
+
+	value_lock();
 	memcpy(&proxy->value, value, sizeof(*value));
 	/*
 	 * Set string length if raw data. 'value_len' can be ignored for basic
@@ -325,14 +966,30 @@ s8_t proxy_write(u8_t id, const knot_value_type *value, u8_t value_len)
 	if (proxy->schema.value_type == KNOT_VALUE_TYPE_RAW)
 		proxy->rlen = value_len;
 
+#if CONFIG_KNOT_FLOAT_FIXED
+	if (proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT)
+		proxy->value_q16 = float_bits_to_q16(proxy->value.val_i);
+#endif
+
+	/* Cloud may set counters total */
+	if (atomic_test_bit(&proxy->flags, PROXY_FLAG_COUNTER))
+		proxy->count = proxy->value.val_i;
+	value_unlock();
+
 	/*
 	 * New values sent from cloud are informed to
 	 * the user app through write callback.
 	 */
 
-	proxy->changed_cb(proxy);
+#if CONFIG_KNOT_PROXY_CB_WORK_Q
+	submit_cb(proxy, false);
+
+	return 0;
+#else
+	run_cb(proxy, proxy->changed_cb, "Changed");
 
 	return proxy->olen;
+#endif
 }
 
 s8_t proxy_force_send(u8_t id)
@@ -345,7 +1002,9 @@ s8_t proxy_force_send(u8_t id)
 	proxy = &proxy_pool[id];
 
 	/* Flag 'value' to be sent, but don't wait response */
+	value_lock();
 	proxy->send = true;
+	value_unlock();
 
 	return 0;
 }
@@ -360,7 +1019,9 @@ s8_t proxy_confirm_sent(u8_t id)
 		return -EINVAL;
 
 	/* No need to resend */
+	value_lock();
 	proxy->send = false;
+	value_unlock();
 
 	return 0;
 }
@@ -374,84 +1035,647 @@ static bool check_timeout(struct knot_proxy *proxy)
 
 	current_time = k_uptime_get();
 	elapsed_time = current_time - proxy->last_timeout;
-	if (elapsed_time >= (proxy->config.time_sec * 1000)) {
+	if (elapsed_time >= (proxy->config.time_sec * 1000U * period_scale)) {
 		proxy->last_timeout = current_time;
 		return true;
 	}
 	return false;
 }
 
-bool knot_proxy_value_set_basic(struct knot_proxy *proxy, const void *value)
+#if CONFIG_KNOT_PROXY_HISTORY_POOL > 0
+/* Add sample to proxy history, dropping the oldest one if full */
+static void history_add(struct knot_proxy *proxy, const void *value)
 {
-	bool change;
-	bool upper;
-	bool lower;
-	bool timeout;
-	bool ret;
+	union history_sample *slots;
+	union history_sample *slot;
+	unsigned int key;
+#if !CONFIG_KNOT_FLOAT_FIXED
+	int i;
+#endif
 
-	bool bval;
-	s32_t s32val;
-	float fval;
+	if (proxy->history.size == 0)
+		return;
 
-	ret = false; /* Default not sending */
+	slots = &history_pool[proxy->history.start];
+	slot = &slots[proxy->history.head];
 
-	if (unlikely(!proxy))
-		goto done;
+	key = irq_lock();
 
-	timeout = check_timeout(proxy);
-	switch(proxy->schema.value_type) {
+	switch (proxy->schema.value_type) {
 	case KNOT_VALUE_TYPE_BOOL:
-		bval = *((bool *) value);
-		change = check_bool_change(proxy, bval);
-
-		if (proxy->send || timeout || change) {
-			proxy->olen = sizeof(bool);
-			proxy->value.val_b = bval;
-			proxy->send = proxy->wait_resp;
-			ret = true;
-		}
+		slot->val_b = *((bool *) value);
 		break;
 	case KNOT_VALUE_TYPE_INT:
-		s32val = *((s32_t *) value);
-		change = check_int_change(proxy, s32val);
-		upper = check_int_upper_threshold(proxy, s32val);
-		lower = check_int_lower_threshold(proxy, s32val);
-
-		if ( proxy->send || timeout || change ||
-		    (upper && proxy->upper_flag == false) ||
-		    (lower && proxy->lower_flag == false)) {
-			proxy->olen = sizeof(int);
-			proxy->value.val_i = s32val;
-			proxy->send = proxy->wait_resp;
-			ret = true;
-		}
-		proxy->upper_flag = upper; /* Send only at crossing */
-		proxy->lower_flag = lower; /* Send only at crossing */
+		if (proxy->history.count == proxy->history.size)
+			proxy->history.sum_i -= slot->val_i;
+		slot->val_i = *((s32_t *) value);
+		proxy->history.sum_i += slot->val_i;
 		break;
 	case KNOT_VALUE_TYPE_FLOAT:
-		fval = *((float *) value);
-		change = check_int_change(proxy, fval);
-		upper = check_float_upper_threshold(proxy, fval);
-		lower = check_float_lower_threshold(proxy, fval);
-
-		if ( proxy->send || timeout || change ||
-		    (upper && proxy->upper_flag == false) ||
-		    (lower && proxy->lower_flag == false)) {
-			proxy->olen = sizeof(float);
-			proxy->value.val_f = fval;
-			proxy->send = proxy->wait_resp;
-			ret = true;
-		}
-		proxy->upper_flag = upper; /* Send only at crossing */
-		proxy->lower_flag = lower; /* Send only at crossing */
+#if CONFIG_KNOT_FLOAT_FIXED
+		/* Samples kept as float bits, sum as Q16.16 */
+		if (proxy->history.count == proxy->history.size)
+			proxy->history.sum_i -= float_bits_to_q16(slot->val_i);
+		slot->val_i = float_bits(value);
+		proxy->history.sum_i += float_bits_to_q16(slot->val_i);
+#else
+		if (proxy->history.count == proxy->history.size)
+			proxy->history.sum_f -= slot->val_f;
+		slot->val_f = *((float *) value);
+		proxy->history.sum_f += slot->val_f;
+#endif
 		break;
-	default:
-		goto done;
 	}
-done:
+
+	if (proxy->history.count < proxy->history.size)
+		proxy->history.count++;
+
+	proxy->history.head++;
+	if (proxy->history.head == proxy->history.size) {
+		proxy->history.head = 0;
+
+#if !CONFIG_KNOT_FLOAT_FIXED
+		/* Avoid rounding errors piling up on float sum */
+		if (proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT) {
+			proxy->history.sum_f = 0;
+			for (i = 0; i < proxy->history.count; i++)
+				proxy->history.sum_f += slots[i].val_f;
+		}
+#endif
+	}
+
+	irq_unlock(key);
+}
+
+/* Sample 'age' positions older than the newest one */
+static union history_sample *history_at(struct knot_proxy *proxy, u8_t age)
+{
+	int idx = (int) proxy->history.head - 1 - age;
+
+	if (idx < 0)
+		idx += proxy->history.size;
+
+	return &history_pool[proxy->history.start + idx];
+}
+
+bool knot_proxy_history_enable(struct knot_proxy *proxy, u8_t size)
+{
+	if (unlikely(!proxy) || size == 0)
+		return false;
+
+	switch (proxy->schema.value_type) {
+	case KNOT_VALUE_TYPE_BOOL:
+	case KNOT_VALUE_TYPE_INT:
+	case KNOT_VALUE_TYPE_FLOAT:
+		break;
+	default:
+		return false;
+	}
+
+	/* History can't be resized */
+	if (proxy->history.size)
+		return false;
+
+	if (size > CONFIG_KNOT_PROXY_HISTORY_POOL - history_used) {
+		LOG_ERR("History for ID %d failed: "
+			"CONFIG_KNOT_PROXY_HISTORY_POOL (%d) exhausted",
+			proxy->id, CONFIG_KNOT_PROXY_HISTORY_POOL);
+		return false;
+	}
+
+	proxy->history.start = history_used;
+	proxy->history.size = size;
+	proxy->history.head = 0;
+	proxy->history.count = 0;
+	proxy->history.sum_i = 0;
+	history_used += size;
+
+	return true;
+}
+
+int knot_proxy_history_get(struct knot_proxy *proxy, void *values, u8_t len)
+{
+	union history_sample *sample;
+	unsigned int key;
+	int i;
+
+	if (unlikely(!proxy) || proxy->history.size == 0)
+		return -EINVAL;
+
+	key = irq_lock();
+
+	len = MIN(len, proxy->history.count);
+	for (i = 0; i < len; i++) {
+		sample = history_at(proxy, i);
+		switch (proxy->schema.value_type) {
+		case KNOT_VALUE_TYPE_BOOL:
+			((bool *) values)[i] = sample->val_b;
+			break;
+		case KNOT_VALUE_TYPE_INT:
+			((s32_t *) values)[i] = sample->val_i;
+			break;
+		case KNOT_VALUE_TYPE_FLOAT:
+#if CONFIG_KNOT_FLOAT_FIXED
+			memcpy(&((float *) values)[i], &sample->val_i,
+			       sizeof(float));
+#else
+			((float *) values)[i] = sample->val_f;
+#endif
+			break;
+		}
+	}
+
+	irq_unlock(key);
+
+	return len;
+}
+
+#if CONFIG_KNOT_FLOAT_FIXED
+/* Float stats compared as Q16.16. Min and max keep the exact samples */
+static void history_stats_q16(struct knot_proxy *proxy,
+			      struct knot_proxy_stats *stats)
+{
+	union history_sample *sample;
+	s32_t min_q16 = INT_MAX;
+	s32_t max_q16 = INT_MIN;
+	s32_t q16val;
+	int i;
+
+	for (i = 0; i < stats->count; i++) {
+		sample = history_at(proxy, i);
+		q16val = float_bits_to_q16(sample->val_i);
+		if (q16val < min_q16) {
+			min_q16 = q16val;
+			stats->min.val_i = sample->val_i;
+		}
+		if (q16val > max_q16) {
+			max_q16 = q16val;
+			stats->max.val_i = sample->val_i;
+		}
+	}
+
+	stats->mean.val_i = q16_to_float_bits(proxy->history.sum_i /
+					      stats->count);
+}
+#endif
+
+bool knot_proxy_history_stats(struct knot_proxy *proxy,
+			      struct knot_proxy_stats *stats)
+{
+	union history_sample *sample;
+	unsigned int key;
+	int i;
+
+	if (unlikely(!proxy) || proxy->history.size == 0)
+		return false;
+
+	if (proxy->schema.value_type != KNOT_VALUE_TYPE_INT &&
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_FLOAT)
+		return false;
+
+	key = irq_lock();
+
+	stats->count = proxy->history.count;
+	if (stats->count == 0) {
+		irq_unlock(key);
+		return false;
+	}
+
+	/* Mean from running sum. Min and max over kept samples */
+	sample = history_at(proxy, 0);
+#if CONFIG_KNOT_FLOAT_FIXED
+	if (proxy->schema.value_type == KNOT_VALUE_TYPE_FLOAT) {
+		history_stats_q16(proxy, stats);
+		irq_unlock(key);
+		return true;
+	}
+#endif
+	if (proxy->schema.value_type == KNOT_VALUE_TYPE_INT) {
+		stats->mean.val_i = proxy->history.sum_i / stats->count;
+		stats->min.val_i = sample->val_i;
+		stats->max.val_i = sample->val_i;
+	} else {
+		stats->mean.val_f = proxy->history.sum_f / stats->count;
+		stats->min.val_f = sample->val_f;
+		stats->max.val_f = sample->val_f;
+	}
+
+	for (i = 1; i < stats->count; i++) {
+		sample = history_at(proxy, i);
+		if (proxy->schema.value_type == KNOT_VALUE_TYPE_INT) {
+			stats->min.val_i = MIN(stats->min.val_i, sample->val_i);
+			stats->max.val_i = MAX(stats->max.val_i, sample->val_i);
+		} else {
+			stats->min.val_f = MIN(stats->min.val_f, sample->val_f);
+			stats->max.val_f = MAX(stats->max.val_f, sample->val_f);
+		}
+	}
+
+	irq_unlock(key);
+
+	return true;
+}
+#else
+static inline void history_add(struct knot_proxy *proxy, const void *value)
+{
+}
+
+bool knot_proxy_history_enable(struct knot_proxy *proxy, u8_t size)
+{
+	LOG_ERR("History disabled: CONFIG_KNOT_PROXY_HISTORY_POOL is 0");
+	return false;
+}
+
+int knot_proxy_history_get(struct knot_proxy *proxy, void *values, u8_t len)
+{
+	return -ENOTSUP;
+}
+
+bool knot_proxy_history_stats(struct knot_proxy *proxy,
+			      struct knot_proxy_stats *stats)
+{
+	return false;
+}
+#endif
+
+/* Typed evaluation. Proxy and value type must be already checked */
+static bool eval_bool(struct knot_proxy *proxy, bool bval)
+{
+	bool change;
+	bool timeout;
+	bool ret = false;
+
+	history_add(proxy, &bval);
+
+	value_lock();
+
+	timeout = check_timeout(proxy);
+	change = check_bool_change(proxy, bval);
+
+	if (proxy->send || timeout || change) {
+		proxy->olen = sizeof(bool);
+		proxy->value.val_b = bval;
+		proxy->send = proxy->wait_resp;
+		ret = true;
+	}
+
+	value_unlock();
+
 	return ret;
 }
 
+static bool eval_int(struct knot_proxy *proxy, s32_t s32val)
+{
+	bool change;
+	bool upper;
+	bool lower;
+	bool timeout;
+	bool ret = false;
+
+	history_add(proxy, &s32val);
+
+	value_lock();
+
+	timeout = check_timeout(proxy);
+	change = check_int_change(proxy, s32val);
+	upper = check_int_upper_threshold(proxy, s32val);
+	lower = check_int_lower_threshold(proxy, s32val);
+
+	if ( proxy->send || timeout || change ||
+	    (upper && proxy->upper_flag == false) ||
+	    (lower && proxy->lower_flag == false)) {
+		proxy->olen = sizeof(int);
+		proxy->value.val_i = s32val;
+		proxy->send = proxy->wait_resp;
+		ret = true;
+	}
+	proxy->upper_flag = upper; /* Send only at crossing */
+	proxy->lower_flag = lower; /* Send only at crossing */
+
+	value_unlock();
+
+	return ret;
+}
+
+#if CONFIG_KNOT_FLOAT_FIXED
+/* Float given as its bits, evaluated as Q16.16 */
+static bool eval_float(struct knot_proxy *proxy, u32_t bits)
+{
+	bool change;
+	bool upper;
+	bool lower;
+	bool timeout;
+	bool ret = false;
+	s32_t q16val;
+
+	history_add(proxy, &bits);
+
+	value_lock();
+
+	timeout = check_timeout(proxy);
+	q16val = float_bits_to_q16(bits);
+	change = check_q16_change(proxy, q16val);
+	upper = check_q16_upper_threshold(proxy, q16val);
+	lower = check_q16_lower_threshold(proxy, q16val);
+
+	if ( proxy->send || timeout || change ||
+	    (upper && proxy->upper_flag == false) ||
+	    (lower && proxy->lower_flag == false)) {
+		proxy->olen = sizeof(float);
+		proxy->value.val_i = bits;
+		proxy->value_q16 = q16val;
+		proxy->send = proxy->wait_resp;
+		ret = true;
+	}
+	proxy->upper_flag = upper; /* Send only at crossing */
+	proxy->lower_flag = lower; /* Send only at crossing */
+
+	value_unlock();
+
+	return ret;
+}
+#else
+static bool eval_float(struct knot_proxy *proxy, float fval)
+{
+	bool change;
+	bool upper;
+	bool lower;
+	bool timeout;
+	bool ret = false;
+
+	history_add(proxy, &fval);
+
+	value_lock();
+
+	timeout = check_timeout(proxy);
+	change = check_float_change(proxy, fval);
+	upper = check_float_upper_threshold(proxy, fval);
+	lower = check_float_lower_threshold(proxy, fval);
+
+	if ( proxy->send || timeout || change ||
+	    (upper && proxy->upper_flag == false) ||
+	    (lower && proxy->lower_flag == false)) {
+		proxy->olen = sizeof(float);
+		proxy->value.val_f = fval;
+		proxy->send = proxy->wait_resp;
+		ret = true;
+	}
+	proxy->upper_flag = upper; /* Send only at crossing */
+	proxy->lower_flag = lower; /* Send only at crossing */
+
+	value_unlock();
+
+	return ret;
+}
+#endif
+
+bool knot_proxy_value_set_basic(struct knot_proxy *proxy, const void *value)
+{
+	if (unlikely(!proxy))
+		return false;
+
+	switch(proxy->schema.value_type) {
+	case KNOT_VALUE_TYPE_BOOL:
+		return eval_bool(proxy, *((bool *) value));
+	case KNOT_VALUE_TYPE_INT:
+		return eval_int(proxy, *((s32_t *) value));
+	case KNOT_VALUE_TYPE_FLOAT:
+#if CONFIG_KNOT_FLOAT_FIXED
+		return eval_float(proxy, float_bits(value));
+#else
+		return eval_float(proxy, *((float *) value));
+#endif
+	default:
+		return false;
+	}
+}
+
+bool knot_proxy_value_set_bool(struct knot_proxy *proxy, bool value)
+{
+	if (unlikely(!proxy) ||
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_BOOL)
+		return false;
+
+	return eval_bool(proxy, value);
+}
+
+bool knot_proxy_value_set_int(struct knot_proxy *proxy, s32_t value)
+{
+	if (unlikely(!proxy) ||
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_INT)
+		return false;
+
+	return eval_int(proxy, value);
+}
+
+bool knot_proxy_value_set_float(struct knot_proxy *proxy, float value)
+{
+	if (unlikely(!proxy) ||
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_FLOAT)
+		return false;
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	return eval_float(proxy, float_bits(&value));
+#else
+	return eval_float(proxy, value);
+#endif
+}
+
+bool knot_proxy_value_set_q16(struct knot_proxy *proxy, s32_t value)
+{
+	if (unlikely(!proxy) ||
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_FLOAT)
+		return false;
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	return eval_float(proxy, q16_to_float_bits(value));
+#else
+	return eval_float(proxy, value / 65536.0f);
+#endif
+}
+
+bool knot_proxy_set_sample_period(struct knot_proxy *proxy, u32_t period)
+{
+	if (unlikely(!proxy))
+		return false;
+
+	proxy->sample_period = period;
+	/* First sample on next pass */
+	atomic_set_bit(&proxy->flags, PROXY_FLAG_SAMPLE);
+	proto_wakeup();
+
+	return true;
+}
+
+void knot_proxy_sample_request(struct knot_proxy *proxy)
+{
+	if (unlikely(!proxy))
+		return;
+
+	atomic_set_bit(&proxy->flags, PROXY_FLAG_SAMPLE);
+	proto_wakeup();
+}
+
+/* Stage sample to be evaluated by PROTO. May be called from ISRs */
+static bool stage_value(struct knot_proxy *proxy, const void *value,
+			bool publish)
+{
+	unsigned int key;
+	size_t len;
+
+	switch (proxy->schema.value_type) {
+	case KNOT_VALUE_TYPE_BOOL:
+		len = sizeof(bool);
+		break;
+	case KNOT_VALUE_TYPE_INT:
+		len = sizeof(s32_t);
+		break;
+	case KNOT_VALUE_TYPE_FLOAT:
+		len = sizeof(float);
+		break;
+	default:
+		return false;
+	}
+
+	/*
+	 * Newer samples replace the ones not evaluated yet. Sample and
+	 * flags change together, so a reader never takes one without
+	 * the other.
+	 */
+	key = irq_lock();
+	memcpy(&proxy->staged, value, len);
+	if (publish)
+		atomic_set_bit(&proxy->flags, PROXY_FLAG_PUBLISH);
+	atomic_set_bit(&proxy->flags, PROXY_FLAG_STAGED);
+	irq_unlock(key);
+
+	proto_wakeup();
+
+	return true;
+}
+
+bool knot_proxy_value_complete(struct knot_proxy *proxy, const void *value)
+{
+	if (unlikely(!proxy))
+		return false;
+
+	return stage_value(proxy, value, false);
+}
+
+bool knot_proxy_value_complete_q16(struct knot_proxy *proxy, s32_t value)
+{
+	u32_t bits;
+
+	if (unlikely(!proxy))
+		return false;
+
+	switch (proxy->schema.value_type) {
+	case KNOT_VALUE_TYPE_INT:
+		value >>= 16;
+		return knot_proxy_value_complete(proxy, &value);
+	case KNOT_VALUE_TYPE_FLOAT:
+		/* No float math: may be called from ISRs */
+		bits = q16_to_float_bits(value);
+		return knot_proxy_value_complete(proxy, &bits);
+	default:
+		return false;
+	}
+}
+
+bool knot_proxy_publish(struct knot_proxy *proxy, const void *value)
+{
+	if (unlikely(!proxy))
+		return false;
+
+	return stage_value(proxy, value, true);
+}
+
+bool knot_proxy_publish_count(struct knot_proxy *proxy, s32_t delta)
+{
+	if (unlikely(!proxy))
+		return false;
+
+	if (proxy->schema.value_type != KNOT_VALUE_TYPE_INT)
+		return false;
+
+	atomic_set_bit(&proxy->flags, PROXY_FLAG_COUNTER);
+	atomic_add(&proxy->pending_count, delta);
+	proto_wakeup();
+
+	return true;
+}
+
+int knot_proxy_value_set_bulk(u8_t first_id, u8_t count,
+			      const s32_t *samples, const s32_t *deadbands,
+			      u32_t *send_map)
+{
+	struct knot_proxy *proxy;
+	u32_t elapsed_time;
+	u32_t current_time;
+	s32_t deadband;
+	s64_t diff;
+	u8_t flags;
+	bool change;
+	bool upper;
+	bool lower;
+	bool timeout;
+	bool send;
+	int sent = 0;
+	int i;
+
+	if (first_id >= CONFIG_KNOT_THING_DATA_MAX ||
+	    count > CONFIG_KNOT_THING_DATA_MAX - first_id)
+		return -EINVAL;
+
+	memset(send_map, 0, DIV_ROUND_UP(count, 32) * sizeof(u32_t));
+	current_time = k_uptime_get_32();
+
+	value_lock();
+
+	for (i = 0; i < count; i++) {
+		proxy = &proxy_pool[first_id + i];
+		if (proxy->id == 0xff ||
+		    proxy->schema.value_type != KNOT_VALUE_TYPE_INT)
+			continue;
+
+		/* Evaluate every event without branching on flags */
+		flags = proxy->config.event_flags;
+		elapsed_time = current_time - proxy->last_timeout;
+		diff = (s64_t) samples[i] - proxy->value.val_i;
+		deadband = (deadbands ? deadbands[i] : 0);
+		change = (flags & KNOT_EVT_FLAG_CHANGE) &&
+			 (diff > deadband || diff < -deadband);
+		upper = (flags & KNOT_EVT_FLAG_UPPER_THRESHOLD) &&
+			samples[i] > proxy->config.upper_limit.val_i;
+		lower = (flags & KNOT_EVT_FLAG_LOWER_THRESHOLD) &&
+			samples[i] < proxy->config.lower_limit.val_i;
+		timeout = (flags & KNOT_EVT_FLAG_TIME) &&
+			  elapsed_time >= (proxy->config.time_sec * 1000U *
+					   period_scale);
+
+		send = proxy->send | change | timeout |
+		       (upper & !proxy->upper_flag) |
+		       (lower & !proxy->lower_flag);
+
+		if (send == false) {
+			/* No crossing: keep state as if evaluated */
+			proxy->upper_flag = upper;
+			proxy->lower_flag = lower;
+			history_add(proxy, &samples[i]);
+			continue;
+		}
+
+		/* Sent on next read, evaluated as a published sample */
+		send_map[i / 32] |= BIT(i % 32);
+		knot_proxy_publish(proxy, &samples[i]);
+		sent++;
+	}
+
+	value_unlock();
+
+	return sent;
+}
+
 bool knot_proxy_value_set_string(struct knot_proxy *proxy,
 				 const char *value, int len)
 {
@@ -464,13 +1688,17 @@ bool knot_proxy_value_set_string(struct knot_proxy *proxy,
 	if (proxy->schema.value_type != KNOT_VALUE_TYPE_RAW)
 		return false;
 
+	value_lock();
+
 	timeout = check_timeout(proxy);
 
 	/* Match current value? */
 	change = check_raw_change(proxy, value, len);
 
-	if (!proxy->send && !change && !timeout)
+	if (!proxy->send && !change && !timeout) {
+		value_unlock();
 		return false;
+	}
 
 	/* len may not include null */
 	len = MIN(KNOT_DATA_RAW_SIZE, len);
@@ -479,6 +1707,8 @@ bool knot_proxy_value_set_string(struct knot_proxy *proxy,
 	memcpy(proxy->value.raw, value, len);
 	proxy->send = proxy->wait_resp;
 
+	value_unlock();
+
 	return true;
 }
 
@@ -486,7 +1716,9 @@ bool knot_proxy_value_get_basic(struct knot_proxy *proxy, void *value)
 {
 	bool *bval;
 	s32_t *s32val;
+#if !CONFIG_KNOT_FLOAT_FIXED
 	float *fval;
+#endif
 
 	if (unlikely(!proxy))
 		return false;
@@ -501,8 +1733,12 @@ bool knot_proxy_value_get_basic(struct knot_proxy *proxy, void *value)
 		*s32val = proxy->value.val_i;
 		break;
 	case KNOT_VALUE_TYPE_FLOAT:
+#if CONFIG_KNOT_FLOAT_FIXED
+		memcpy(value, &proxy->value.val_i, sizeof(float));
+#else
 		fval = (float *) value;
 		*fval = proxy->value.val_f;
+#endif
 		break;
 	default:
 		return false;
@@ -511,6 +1747,21 @@ bool knot_proxy_value_get_basic(struct knot_proxy *proxy, void *value)
 	return true;
 }
 
+bool knot_proxy_value_get_q16(struct knot_proxy *proxy, s32_t *value)
+{
+	if (unlikely(!proxy) ||
+	    proxy->schema.value_type != KNOT_VALUE_TYPE_FLOAT)
+		return false;
+
+#if CONFIG_KNOT_FLOAT_FIXED
+	*value = proxy->value_q16;
+#else
+	*value = proxy->value.val_f * 65536.0f;
+#endif
+
+	return true;
+}
+
 bool knot_proxy_value_get_string(struct knot_proxy *proxy,
 				 char *value, int len, int *olen)
 {
@@ -520,8 +1771,10 @@ bool knot_proxy_value_get_string(struct knot_proxy *proxy,
 	if (proxy->schema.value_type != KNOT_VALUE_TYPE_RAW)
 		return false;
 
+	value_lock();
 	*olen = MIN(len, proxy->rlen);
 	memcpy(value, proxy->value.raw, *olen);
+	value_unlock();
 
 	return true;
 }
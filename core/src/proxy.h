@@ -14,6 +14,10 @@ void proxy_stop(void);
 
 u8_t proxy_get_last_id(void);
 
+void proxy_set_period_scale(u8_t scale);
+
+s32_t proxy_wait_time(void);
+
 const knot_value_type *proxy_read(u8_t id, uint8_t *olen, bool wait_resp);
 
 s8_t proxy_write(u8_t id, const knot_value_type *value, u8_t value_len);
@@ -21,3 +25,9 @@ s8_t proxy_write(u8_t id, const knot_value_type *value, u8_t value_len);
 s8_t proxy_force_send(u8_t id);
 
 s8_t proxy_confirm_sent(u8_t id);
+
+s8_t proxy_set_config(u8_t id, const knot_config *config);
+
+int proxy_store_config(void);
+
+int proxy_load_config(void);
@@ -0,0 +1,40 @@
+/* retained.c - Values retained across warm reboots */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Setup and main apps share the GPREGRET2 retained register. It keeps its
+ * value on soft, watchdog and pin resets and is cleared on power-on and
+ * brownout resets, so a cold boot always runs the full settings check.
+ */
+
+#include <zephyr.h>
+
+#if CONFIG_SOC_FAMILY_NRF
+#include <hal/nrf_power.h>
+#endif
+
+#include "retained.h"
+
+/* Magic value marking peer's IPv6 and OpenThread settings as stored */
+#define RETAINED_PROVISIONED	0x4B
+
+void retained_set_provisioned(bool provisioned)
+{
+#if CONFIG_SOC_FAMILY_NRF
+	nrf_power_gpregret2_set(provisioned ? RETAINED_PROVISIONED : 0);
+#endif
+}
+
+bool retained_is_provisioned(void)
+{
+#if CONFIG_SOC_FAMILY_NRF
+	return nrf_power_gpregret2_get() == RETAINED_PROVISIONED;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,10 @@
+/* retained.h - Values retained across warm reboots */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+void retained_set_provisioned(bool provisioned);
+bool retained_is_provisioned(void);
@@ -0,0 +1,121 @@
+/* ring.c - KNoT single producer/single consumer message ring */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Messages exchanged between PROTO and NET threads. Each direction has a
+ * single producer and a single consumer, so slots are handed over by
+ * publishing head and tail indexes without taking any kernel lock. The
+ * semaphore is only a wakeup signal for consumers willing to wait. It is
+ * given on every put and may be left given for messages already read, so
+ * waiters check the indexes again after waking up.
+ */
+
+#include <zephyr.h>
+#include <atomic.h>
+#include <string.h>
+
+#include "ring.h"
+
+BUILD_ASSERT((RING_SLOTS & (RING_SLOTS - 1)) == 0);
+
+void ring_init(struct ring *ring)
+{
+	atomic_set(&ring->head, 0);
+	atomic_set(&ring->tail, 0);
+	k_sem_init(&ring->sem, 0, 1);
+}
+
+int ring_put(struct ring *ring, const void *buf, size_t len)
+{
+	struct ring_slot *slot;
+	atomic_val_t head;
+
+	if (len > RING_SLOT_SIZE)
+		return -EMSGSIZE;
+
+	head = atomic_get(&ring->head);
+
+	/* Full: all slots pending to be read */
+	if (head - atomic_get(&ring->tail) >= RING_SLOTS)
+		return -ENOBUFS;
+
+	slot = &ring->slots[head & (RING_SLOTS - 1)];
+	memcpy(slot->data, buf, len);
+	slot->len = len;
+
+	/* Publish slot. Atomic operations are full barriers */
+	atomic_inc(&ring->head);
+	k_sem_give(&ring->sem);
+
+	return 0;
+}
+
+/*
+ * Wait up to 'timeout' for a message to read. Returns 0 once a message is
+ * available or -EAGAIN if none arrived in time.
+ */
+int ring_wait(struct ring *ring, s32_t timeout)
+{
+	s64_t end = k_uptime_get() + timeout;
+	s64_t left;
+
+	while (atomic_get(&ring->tail) == atomic_get(&ring->head)) {
+		if (k_sem_take(&ring->sem, timeout) != 0)
+			return -EAGAIN;
+
+		/* Signal may refer to a message already read: wait again */
+		if (timeout == K_FOREVER)
+			continue;
+
+		left = end - k_uptime_get();
+		timeout = (left > 0 ? left : K_NO_WAIT);
+	}
+
+	return 0;
+}
+
+/*
+ * Set 'event' to be signaled on the next message put, for waiting along
+ * with other objects on k_poll(). Returns false if a message is already
+ * available, in which case there is nothing to wait for.
+ */
+bool ring_poll_prepare(struct ring *ring, struct k_poll_event *event)
+{
+	k_poll_event_init(event, K_POLL_TYPE_SEM_AVAILABLE,
+			  K_POLL_MODE_NOTIFY_ONLY, &ring->sem);
+
+	/* Drop signal left by messages already read */
+	k_sem_take(&ring->sem, K_NO_WAIT);
+
+	return (atomic_get(&ring->tail) == atomic_get(&ring->head));
+}
+
+/*
+ * Read next message. Wait up to 'timeout' if no message is available.
+ * Returns message length, 0 if none available or negative on error.
+ */
+int ring_get(struct ring *ring, void *buf, size_t size, s32_t timeout)
+{
+	struct ring_slot *slot;
+	atomic_val_t tail;
+	size_t len;
+
+	if (ring_wait(ring, timeout))
+		return 0;
+
+	tail = atomic_get(&ring->tail);
+	slot = &ring->slots[tail & (RING_SLOTS - 1)];
+	len = slot->len;
+	if (len <= size)
+		memcpy(buf, slot->data, len);
+
+	/* Release slot to producer. Messages not fitting 'buf' are dropped */
+	atomic_inc(&ring->tail);
+
+	return (len <= size ? len : -EMSGSIZE);
+}
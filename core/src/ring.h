@@ -0,0 +1,34 @@
+/* ring.h - KNoT single producer/single consumer message ring */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Considering KNOT Max MTU 128 */
+#define RING_SLOT_SIZE		128
+#define RING_SLOTS		4 /* Must be power of 2 */
+
+struct ring_slot {
+	u8_t			len;
+	u8_t			data[RING_SLOT_SIZE];
+};
+
+/*
+ * Lock-free ring of fixed-size message slots. Must have only one producer
+ * thread and only one consumer thread.
+ */
+struct ring {
+	atomic_t		head; /* Next slot to write. Producer owned */
+	atomic_t		tail; /* Next slot to read. Consumer owned */
+	struct k_sem		sem; /* Wakes up consumer on new messages */
+	struct ring_slot	slots[RING_SLOTS];
+};
+
+void ring_init(struct ring *ring);
+
+int ring_put(struct ring *ring, const void *buf, size_t len);
+int ring_wait(struct ring *ring, s32_t timeout);
+bool ring_poll_prepare(struct ring *ring, struct k_poll_event *event);
+int ring_get(struct ring *ring, void *buf, size_t size, s32_t timeout);
@@ -18,6 +18,9 @@
 #include "sm.h"
 #include "storage.h"
 #include "peripheral.h"
+#include "boot_time.h"
+#include "ring.h"
+#include "proto.h"
 
 LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
@@ -36,6 +39,9 @@ static char uuid[KNOT_PROTOCOL_UUID_LEN + 1];	/* Device uuid */
 static char token[KNOT_PROTOCOL_TOKEN_LEN + 1];	/* Device token */
 static u64_t device_id;				/* Device id */
 
+static u8_t throttle_scale;	/* Report periods scale under congestion */
+static u16_t throttle_acks;	/* Successful responses since last change */
+
 enum sm_state {
 	STATE_REG,		/* Registers new device */
 	STATE_AUTH,		/* Authenticate known device */
@@ -51,6 +57,7 @@ static void timer_expired(struct k_timer *to)
 	to_xpr = true;
 	to_on = false;
 	LOG_WRN("Timeout expired!");
+	proto_wakeup();
 }
 
 static bool cmp_opcode(const u8_t xpt_opcode, const u8_t *ipdu, size_t ilen)
@@ -86,17 +93,85 @@ static bool wl_opcode(const enum sm_state state, const u8_t *ipdu, size_t ilen)
 
 	/* Return true if find expected response */
 	switch (imsg->hdr.type) {
-	/* TODO: Add, after implement,
-	 * UNREG_REQ, SET_CONFIG, and GET_CONFIG
-	 */
+	/* TODO: Add, after implement, GET_CONFIG */
+	case KNOT_MSG_UNREG_REQ:
 	case KNOT_MSG_PUSH_DATA_REQ:
 	case KNOT_MSG_POLL_DATA_REQ:
+	case KNOT_MSG_PUSH_CONFIG_REQ:
 		return true;
 	default:
 		return false;
 	}
 }
 
+/*
+ * Failed or expired data responses mean the gateway is overloaded. Back off
+ * doubling every report period and recover one step at a time after
+ * consecutive successful responses.
+ */
+static void throttle_update(bool congested)
+{
+	u8_t scale = throttle_scale;
+
+	if (congested) {
+		throttle_acks = 0;
+		scale = scale * 2;
+		if (scale > CONFIG_KNOT_THROTTLE_MAX_SCALE)
+			scale = CONFIG_KNOT_THROTTLE_MAX_SCALE;
+	} else if (scale > 1 &&
+		   ++throttle_acks >= CONFIG_KNOT_THROTTLE_RECOVER_COUNT) {
+		throttle_acks = 0;
+		scale /= 2;
+	}
+
+	if (scale == throttle_scale)
+		return;
+
+	LOG_INF("Report periods scaled by %d", scale);
+	throttle_scale = scale;
+	proxy_set_period_scale(scale);
+}
+
+/* Generate a new device id. Used when no credentials are available */
+static void create_device_id(void)
+{
+	device_id = sys_rand32_get();
+	device_id *= device_id;
+}
+
+/*
+ * Forget credentials both in RAM and NVM so the device can register
+ * again without rebooting. Peer address and OpenThread settings are kept.
+ */
+static int unregister(void)
+{
+	int rc;
+	int ret = 0;
+
+	rc = storage_clear(STORAGE_CRED_UUID);
+	if (rc)
+		ret = rc;
+
+	rc = storage_clear(STORAGE_CRED_TOKEN);
+	if (rc)
+		ret = rc;
+
+	rc = storage_clear(STORAGE_CRED_DEVID);
+	if (rc)
+		ret = rc;
+
+	/* Nothing of the old registration left pending to be saved */
+	rc = storage_flush();
+	if (rc)
+		ret = rc;
+
+	memset(uuid, 0, sizeof(uuid));
+	memset(token, 0, sizeof(token));
+	create_device_id();
+
+	return ret;
+}
+
 static enum sm_state state_register(u8_t *xpt_opcode,
 				    const u8_t *ipdu, size_t ilen,
 				    u8_t *opdu, size_t olen, size_t *len)
@@ -224,6 +299,13 @@ static enum sm_state state_schema(u8_t *xpt_opcode,
 			next = STATE_ERROR;
 			goto done;
 		}
+		/* Reset before write-behind saves would register again */
+		res = storage_flush();
+		if (res) {
+			LOG_ERR("Failed to save credentials");
+			next = STATE_ERROR;
+			goto done;
+		}
 
 		LOG_INF("Successfully registered!");
 		LOG_INF("UUID: %s", uuid);
@@ -285,14 +367,18 @@ static size_t process_event(u8_t *xpt_opcode,
 		err = imsg->action.result;
 		LOG_ERR("FAIL SEND FOR ID %d (err: %d)", id_index, err);
 
-		if (err != KNOT_ERR_PERM)
+		if (err != KNOT_ERR_PERM) {
+			throttle_update(true);
 			goto polling;
+		}
 
 		/* Permission error found */
 		*perm_error = true;
 		return 0;
-	} else
+	} else {
 		proxy_confirm_sent(id_index);
+		throttle_update(false);
+	}
 
 polling:
 	/*
@@ -322,7 +408,7 @@ polling:
 }
 
 static size_t process_cmd(const u8_t *ipdu, size_t ilen,
-			  u8_t *opdu, size_t olen)
+			  u8_t *opdu, size_t olen, bool *unreg)
 {
 	const knot_msg *imsg = (knot_msg *) ipdu;
 	knot_msg *omsg = (knot_msg *) opdu;
@@ -335,6 +421,12 @@ static size_t process_cmd(const u8_t *ipdu, size_t ilen,
 	switch (imsg->hdr.type) {
 	case KNOT_MSG_UNREG_REQ:
 		/* Clear NVM */
+		if (unregister() < 0)
+			LOG_WRN("Failed to clear credentials");
+
+		LOG_INF("Device unregistered");
+		len = msg_create_error(omsg, KNOT_MSG_UNREG_RSP, 0);
+		*unreg = true;
 		break;
 	case KNOT_MSG_POLL_DATA_REQ:
 		id = imsg->data.sensor_id;
@@ -352,6 +444,12 @@ static size_t process_cmd(const u8_t *ipdu, size_t ilen,
 		proxy_force_send(id);
 		value = proxy_read(id, &value_len, false);
 
+		/* Polled on work queue: value sent when poll finishes */
+		if (IS_ENABLED(CONFIG_KNOT_PROXY_CB_WORK_Q) && !value) {
+			LOG_DBG("Value for Id %d requested", id);
+			break;
+		}
+
 		/* FIXME: */
 		/* Couldn't read value */
 		if (unlikely(!value)) {
@@ -383,7 +481,23 @@ static size_t process_cmd(const u8_t *ipdu, size_t ilen,
 		len = msg_create_data(omsg, id, value, value_len, true);
 		break;
 	case KNOT_MSG_PUSH_CONFIG_REQ:
-		/* TODO */
+		id = imsg->config.sensor_id;
+
+		/* Same validation used by knot_proxy_set_config() */
+		if (proxy_set_config(id, &imsg->config.values) < 0) {
+			len = msg_create_error(omsg,
+					       KNOT_MSG_PUSH_CONFIG_RSP,
+					       KNOT_ERR_INVALID);
+			LOG_WRN("Invalid config for Id %d", id);
+			break;
+		}
+
+		/* Keep remote config across reboots */
+		if (proxy_store_config() < 0)
+			LOG_WRN("Config for Id %d not persisted", id);
+
+		/* Acknowledge echoing applied config */
+		len = msg_create_config(omsg, id, &imsg->config.values, true);
 		break;
 	default:
 		break;
@@ -399,11 +513,18 @@ static enum sm_state state_online(u8_t *xpt_opcode,
 	enum sm_state next = STATE_ONLINE;
 	size_t ret_len = 0;
 	bool perm_error = false;
+	bool unreg = false;
 
 	/* Incoming commands: higher priority */
 	if (ilen != 0)
 		/* Received command */
-		ret_len = process_cmd(ipdu, ilen, opdu, olen);
+		ret_len = process_cmd(ipdu, ilen, opdu, olen, &unreg);
+
+	/* Register again as a new device */
+	if (unreg) {
+		next = STATE_REG;
+		goto done;
+	}
 
 	/* Local sensor/actuator */
 	if (ret_len == 0) {
@@ -418,6 +539,7 @@ static enum sm_state state_online(u8_t *xpt_opcode,
 		}
 	}
 
+done:
 	if (ret_len > 0)
 		*len = ret_len;
 
@@ -469,8 +591,7 @@ int sm_start(void)
 
 	/* Go to register if no credentials found */
 	LOG_INF("KNoT credentials not found");
-	device_id = sys_rand32_get();
-	device_id *= device_id;
+	create_device_id();
 	state = STATE_REG;
 	LOG_DBG("STATE: REG");
 
@@ -502,6 +623,10 @@ void sm_init(void)
 
 	/* Initializing proxy slots */
 	proxy_init();
+
+	/* Not throttled until congestion is detected */
+	throttle_scale = 1;
+	throttle_acks = 0;
 }
 
 int sm_run(const u8_t *ipdu, size_t ilen, u8_t *opdu, size_t olen)
@@ -572,10 +697,14 @@ int sm_run(const u8_t *ipdu, size_t ilen, u8_t *opdu, size_t olen)
 			break;
 		case STATE_SCH:
 			LOG_DBG("STATE: SCH");
+			boot_time_mark(BOOT_TIME_AUTH);
 			break;
 		case STATE_ONLINE:
 			LOG_DBG("STATE: ONLINE");
 			status_blink_period = STATUS_CONN_PERIOD;
+			boot_time_mark(BOOT_TIME_AUTH);
+			boot_time_mark(BOOT_TIME_ONLINE);
+			boot_time_report();
 			break;
 		default:
 			LOG_DBG("STATE: ERROR");
@@ -611,3 +740,19 @@ done:
 
 	return len;
 }
+
+s32_t sm_wait_time(void)
+{
+	/* Response or its timeout wakes PROTO up */
+	if (to_on)
+		return K_FOREVER;
+
+	switch (state) {
+	case STATE_ONLINE:
+		return proxy_wait_time();
+	case STATE_ERROR:
+		return K_FOREVER;
+	default:
+		return K_MSEC(CONFIG_KNOT_PASS_PERIOD);
+	}
+}
@@ -13,3 +13,6 @@ int sm_start(void);
 void sm_stop(void);
 
 int sm_run(const u8_t *ipdu, size_t ilen, u8_t *opdu, size_t olen);
+
+/* Time in ms until sm_run() must run without new messages */
+s32_t sm_wait_time(void);
@@ -24,6 +24,10 @@ LOG_MODULE_REGISTER(knot_storage, CONFIG_KNOT_LOG_LEVEL);
 #include "storage.qemu"
 #else
 #include <settings/settings.h>
+#if CONFIG_KNOT_STORAGE_NVS
+#include <flash.h>
+#include <nvs/nvs.h>
+#endif
 
 /* Storage path identifiers */
 #define NAMESPACE		"knot"
@@ -32,38 +36,152 @@ LOG_MODULE_REGISTER(knot_storage, CONFIG_KNOT_LOG_LEVEL);
 #define TOKEN_KEY		"token"
 #define DEVID_KEY		"devid"
 #define IPV6_KEY		"ipv6"
+#define CONFIG_KEY		"config"
 
 #define SAVE_UUID_KEY		NAMESPACE "/" UUID_KEY
 #define SAVE_TOKEN_KEY		NAMESPACE "/" TOKEN_KEY
 #define SAVE_DEVID_KEY		NAMESPACE "/" DEVID_KEY
 #define SAVE_IPV6_KEY		NAMESPACE "/" IPV6_KEY
+#define SAVE_CONFIG_KEY		NAMESPACE "/" CONFIG_KEY
 
 /* Buffer sizes */
 #define UUID_LEN	36
 #define TOKEN_LEN	40
 #define IPV6_LEN	40
+#define CONFIG_LEN	(CONFIG_KNOT_THING_DATA_MAX * STORAGE_CONFIG_RECORD_LEN)
 
 /* Buffers */
 static char uuid[UUID_LEN];		/* Device UUID */
 static char token[TOKEN_LEN];		/* Device Token */
 static char peer_ipv6[TOKEN_LEN];	/* Peer's IPV6 */
 static uint64_t devid;			/* Device ID */
+static u8_t proxy_config[CONFIG_LEN];	/* Proxies config records */
 
 struct key_fmt {
 	const char *save_key;	/* Settings name or key */
 	void *buffer;		/* Pointer to buffers */
 	size_t bsize;		/* Buffer size */
 	bool loaded;		/* Value loaded from storage */
+	bool dirty;		/* Value pending to be saved */
+	size_t len;		/* Length of value held on buffer */
+#if CONFIG_KNOT_STORAGE_NVS
+	bool legacy;		/* Value loaded from settings to be migrated */
+#endif
 };
 
 /* Map with info of used buffers */
 static struct key_fmt buf_info[] = {
-	{ SAVE_UUID_KEY,	uuid,		sizeof(uuid),		false },
-	{ SAVE_TOKEN_KEY,	token,		sizeof(token),		false },
-	{ SAVE_DEVID_KEY,	&devid,		sizeof(devid),		false },
-	{ SAVE_IPV6_KEY,	peer_ipv6,	sizeof(peer_ipv6),	false },
+	{ SAVE_UUID_KEY,	uuid,		sizeof(uuid),		false, false },
+	{ SAVE_TOKEN_KEY,	token,		sizeof(token),		false, false },
+	{ SAVE_DEVID_KEY,	&devid,		sizeof(devid),		false, false },
+	{ SAVE_IPV6_KEY,	peer_ipv6,	sizeof(peer_ipv6),	false, false },
+	{ SAVE_CONFIG_KEY,	proxy_config,	sizeof(proxy_config),	false, false },
+};
+
+#if CONFIG_KNOT_STORAGE_NVS
+/* NVS ids are storage keys shifted by one */
+#define NVS_ID(key)	((u16_t) (key) + 1)
+
+static struct nvs_fs fs = {
+	.offset = DT_FLASH_AREA_KNOT_STORAGE_OFFSET,
+	.sector_size = DT_FLASH_ERASE_BLOCK_SIZE,
+	.sector_count = DT_FLASH_AREA_KNOT_STORAGE_SIZE /
+			DT_FLASH_ERASE_BLOCK_SIZE,
 };
 
+static int save_value(int key, const void *src, size_t len)
+{
+	ssize_t rc;
+
+	/* Returns 0 if value is unchanged */
+	rc = nvs_write(&fs, NVS_ID(key), src, len);
+
+	return (rc < 0) ? rc : 0;
+}
+
+static int delete_value(int key)
+{
+	return nvs_delete(&fs, NVS_ID(key));
+}
+#else
+static int save_value(int key, const void *src, size_t len)
+{
+	/* Cast to (void *) due to lack of const identifier on value argument */
+	return settings_save_one(buf_info[key].save_key, (void *) src, len);
+}
+
+static int delete_value(int key)
+{
+	return settings_delete(buf_info[key].save_key);
+}
+#endif
+
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+/* Copy of a value being saved, so buffers are not locked during flash I/O */
+static union {
+	char uuid[UUID_LEN];
+	char token[TOKEN_LEN];
+	char peer_ipv6[IPV6_LEN];
+	uint64_t devid;
+	u8_t proxy_config[CONFIG_LEN];
+} flush_buf;
+
+static K_THREAD_STACK_DEFINE(work_q_stack, CONFIG_KNOT_STORAGE_STACK_SIZE);
+static struct k_work_q work_q;
+static struct k_delayed_work flush_work;
+static K_MUTEX_DEFINE(buf_lock);		/* Protects buffers and flags */
+static K_MUTEX_DEFINE(flush_lock);	/* Serializes flash accesses */
+
+/* Save every pending value. Returns first error found */
+static int flush_dirty(void)
+{
+	struct key_fmt *fmt;
+	size_t len;
+	int ret = 0;
+	int err;
+	int i;
+
+	k_mutex_lock(&flush_lock, K_FOREVER);
+
+	for (i = 0; i < ARRAY_SIZE(buf_info); i++) {
+		fmt = &buf_info[i];
+
+		k_mutex_lock(&buf_lock, K_FOREVER);
+		if (fmt->dirty == false) {
+			k_mutex_unlock(&buf_lock);
+			continue;
+		}
+		fmt->dirty = false;
+		/* Only bytes written are saved */
+		len = fmt->len;
+		memcpy(&flush_buf, fmt->buffer, len);
+		k_mutex_unlock(&buf_lock);
+
+		err = save_value(i, &flush_buf, len);
+		if (err == 0)
+			continue;
+
+		LOG_ERR("Failed to save value for key \"%s\"", fmt->save_key);
+		/* Keep it pending for next flush */
+		k_mutex_lock(&buf_lock, K_FOREVER);
+		fmt->dirty = true;
+		k_mutex_unlock(&buf_lock);
+
+		if (ret == 0)
+			ret = err;
+	}
+
+	k_mutex_unlock(&flush_lock);
+
+	return ret;
+}
+
+static void flush_handler(struct k_work *work)
+{
+	flush_dirty();
+}
+#endif
+
 static int set(int argc, char **argv, void *value_ctx)
 {
 	struct key_fmt *fmt;
@@ -81,20 +199,107 @@ static int set(int argc, char **argv, void *value_ctx)
 		fmt = &buf_info[STORAGE_CRED_DEVID];
 	else if (!strcmp(argv[0], IPV6_KEY))
 		fmt = &buf_info[STORAGE_PEER_IPV6];
+	else if (!strcmp(argv[0], CONFIG_KEY))
+		fmt = &buf_info[STORAGE_PROXY_CONFIG];
 	else /* Ignore invalid key */
 		return -ENOENT;
 
+#if CONFIG_KNOT_STORAGE_NVS
+	/* Values written before using NVS. Moved to NVS on commit */
+	fmt->legacy = true;
+
+	/* Value already migrated */
+	if (fmt->loaded)
+		return 0;
+#endif
+
 	/* Get values from storage */
 	rc = settings_val_read_cb(value_ctx, fmt->buffer, fmt->bsize);
 
 	/* Sign if value was loaded or not */
 	fmt->loaded = (rc < 0) ? false : true ;
+	fmt->len = (rc < 0) ? 0 : rc;
 
 	return rc;
 }
 
+#if CONFIG_KNOT_STORAGE_NVS
+/* Move values found on settings to NVS */
+static void migrate(void)
+{
+	struct key_fmt *fmt;
+	int err;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(buf_info); i++) {
+		fmt = &buf_info[i];
+		if (fmt->legacy == false)
+			continue;
+
+		if (fmt->loaded) {
+			err = save_value(i, fmt->buffer, fmt->len);
+			if (err) {
+				LOG_ERR("Failed to migrate key \"%s\" (err %d)",
+					fmt->save_key, err);
+				continue;
+			}
+		}
+
+		err = settings_delete(fmt->save_key);
+		if (err)
+			continue;
+
+		fmt->legacy = false;
+		LOG_DBG("Key \"%s\" migrated to NVS", fmt->save_key);
+	}
+}
+
+static int load_nvs(void)
+{
+	struct device *flash_dev;
+	struct key_fmt *fmt;
+	ssize_t rc;
+	int i;
+
+	rc = nvs_init(&fs, DT_FLASH_DEV_NAME);
+	if (rc) {
+		/* Area used by other storage before. Start from scratch */
+		LOG_WRN("NVS init failed (err %d). Erasing area",
+			(int) rc);
+		flash_dev = device_get_binding(DT_FLASH_DEV_NAME);
+		if (!flash_dev)
+			return -ENODEV;
+
+		flash_write_protection_set(flash_dev, false);
+		rc = flash_erase(flash_dev,
+				 DT_FLASH_AREA_KNOT_STORAGE_OFFSET,
+				 DT_FLASH_AREA_KNOT_STORAGE_SIZE);
+		flash_write_protection_set(flash_dev, true);
+		if (rc)
+			return rc;
+
+		rc = nvs_init(&fs, DT_FLASH_DEV_NAME);
+		if (rc)
+			return rc;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(buf_info); i++) {
+		fmt = &buf_info[i];
+		rc = nvs_read(&fs, NVS_ID(i), fmt->buffer, fmt->bsize);
+		fmt->loaded = (rc > 0);
+		fmt->len = (rc > 0) ? MIN(rc, fmt->bsize) : 0;
+	}
+
+	return 0;
+}
+#endif
+
 static int commit(void)
 {
+#if CONFIG_KNOT_STORAGE_NVS
+	migrate();
+#endif
+
 	if (buf_info[STORAGE_CRED_UUID].loaded &&
 	    buf_info[STORAGE_CRED_TOKEN].loaded &&
 	    buf_info[STORAGE_CRED_DEVID].loaded )
@@ -127,6 +332,16 @@ int storage_init(void)
 		return err;
 	}
 
+#if CONFIG_KNOT_STORAGE_NVS
+	LOG_DBG("Loading values from NVS");
+	err = load_nvs();
+	if (err) {
+		LOG_ERR("NVS load failed (err %d)", err);
+		return err;
+	}
+#endif
+
+	/* Handler also needed to migrate values when using NVS */
 	LOG_DBG("Register settings handler");
 	err = settings_register(&handler);
 	if (err) {
@@ -134,17 +349,35 @@ int storage_init(void)
 		return err;
 	}
 
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+	/* Values are saved on background by a low priority work queue */
+	k_work_q_start(&work_q, work_q_stack,
+		       K_THREAD_STACK_SIZEOF(work_q_stack),
+		       K_LOWEST_APPLICATION_THREAD_PRIO);
+	k_delayed_work_init(&flush_work, flush_handler);
+#endif
+
 	return 0;
 }
 
-static int clear_value(enum storage_keys key)
+int storage_clear(enum storage_keys key)
 {
 	struct key_fmt *fmt;
 	int rc;
 
 	fmt = &buf_info[key];
 
-	rc = settings_delete(fmt->save_key);
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+	/* Drop pending save and avoid racing with an ongoing flush */
+	k_mutex_lock(&flush_lock, K_FOREVER);
+	k_mutex_lock(&buf_lock, K_FOREVER);
+	fmt->dirty = false;
+	k_mutex_unlock(&buf_lock);
+	rc = delete_value(key);
+	k_mutex_unlock(&flush_lock);
+#else
+	rc = delete_value(key);
+#endif
 	if (rc)
 		LOG_ERR("Deleting key \"%s\" failed (err %d)", fmt->save_key,
 							       rc);
@@ -159,19 +392,23 @@ int storage_reset(void)
 	int rc;
 
 	/* Clear app credentials */
-	rc = clear_value(STORAGE_CRED_UUID);
+	rc = storage_clear(STORAGE_CRED_UUID);
+	if (rc)
+		return rc;
+
+	rc = storage_clear(STORAGE_CRED_TOKEN);
 	if (rc)
 		return rc;
 
-	rc = clear_value(STORAGE_CRED_TOKEN);
+	rc = storage_clear(STORAGE_CRED_DEVID);
 	if (rc)
 		return rc;
 
-	rc = clear_value(STORAGE_CRED_DEVID);
+	rc = storage_clear(STORAGE_PROXY_CONFIG);
 	if (rc)
 		return rc;
 
-	return clear_value(STORAGE_PEER_IPV6);
+	return storage_clear(STORAGE_PEER_IPV6);
 }
 
 bool storage_is_set(enum storage_keys key)
@@ -197,7 +434,13 @@ int storage_read(const enum storage_keys key, void *dest, int len)
 
 	/* Return buffer value */
 	olen = (len < fmt->bsize) ? len : fmt->bsize;
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+	k_mutex_lock(&buf_lock, K_FOREVER);
+	memcpy(dest, fmt->buffer, olen);
+	k_mutex_unlock(&buf_lock);
+#else
 	memcpy(dest, fmt->buffer, olen);
+#endif
 
 	return olen;
 }
@@ -208,17 +451,31 @@ int storage_write(enum storage_keys key, const void *src, const int len)
 	int err;
 	int olen;
 
-	if (key < 0 || key >= sizeof(buf_info))
+	if (key < 0 || key >= ARRAY_SIZE(buf_info))
 		return -EINVAL;
 
 	if (len <= 0)
 		return -EINVAL;
 
-	/* Store value */
-	/* Cast to (void *) due to lack of const identifier on value argument */
 	fmt = &buf_info[key];
 	olen = (len < fmt->bsize) ? len : fmt->bsize;
-	err = settings_save_one(fmt->save_key, (void *) src, olen);
+
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+	/* Update buffer and defer saving. Writes in a row are coalesced */
+	k_mutex_lock(&buf_lock, K_FOREVER);
+	memcpy(fmt->buffer, src, olen);
+	fmt->len = olen;
+	fmt->loaded = true;
+	fmt->dirty = true;
+	k_mutex_unlock(&buf_lock);
+
+	err = k_delayed_work_submit_to_queue(&work_q, &flush_work,
+					     CONFIG_KNOT_STORAGE_FLUSH_DELAY);
+	if (err)
+		LOG_WRN("Failed to schedule flush (err %d)", err);
+#else
+	/* Store value */
+	err = save_value(key, src, olen);
 	if (err) {
 		LOG_ERR("Failed to save value for key \"%s\"", fmt->save_key);
 		return err;
@@ -226,12 +483,26 @@ int storage_write(enum storage_keys key, const void *src, const int len)
 
 	/* Save value to buffer */
 	memcpy(fmt->buffer, src, olen);
+	fmt->len = olen;
 
 	/* Set value as available */
 	fmt->loaded = true;
+#endif
 
 	return olen;
 }
 
+int storage_flush(void)
+{
+#if CONFIG_KNOT_STORAGE_WRITE_BEHIND
+	k_delayed_work_cancel(&flush_work);
+
+	return flush_dirty();
+#else
+	/* Values are saved at write */
+	return 0;
+#endif
+}
+
 
 #endif
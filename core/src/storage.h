@@ -12,12 +12,18 @@ enum storage_keys {
 	STORAGE_CRED_TOKEN,
 	STORAGE_CRED_DEVID,
 	STORAGE_PEER_IPV6,
+	STORAGE_PROXY_CONFIG,
 };
 
+/* Stored config record length for each proxy */
+#define STORAGE_CONFIG_RECORD_LEN	12
+
 int storage_init(void);
 int storage_reset(void);
+int storage_clear(enum storage_keys key);
 
 int storage_read(enum storage_keys key, void *dest, int len);
 int storage_write(enum storage_keys key, const void *src, int len);
+int storage_flush(void);
 
 bool storage_is_set(enum storage_keys key);
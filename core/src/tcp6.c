@@ -24,12 +24,22 @@ LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
 #define PEER_IPV6_PORT 8886
 #define IPV6_LEN	40
+#define PEND_LEN	128
+
+/* Event loop can't wait for room on the TCP send window */
+#if CONFIG_KNOT_SINGLE_THREAD
+#define SEND_FLAGS	ZSOCK_MSG_DONTWAIT
+#else
+#define SEND_FLAGS	0
+#endif
 
 static char peer_ipv6[IPV6_LEN];
 static struct zsock_pollfd fds;
 static net_recv_t recv_cb;
 static net_close_t close_cb;
 static int socket;
+static u8_t pend_buf[PEND_LEN]; /* Bytes not accepted by socket yet */
+static size_t pend_len;
 
 static int receive(void)
 {
@@ -141,6 +151,7 @@ int tcp6_start(net_recv_t recv, net_close_t close)
 	/* Successful start */
 	LOG_DBG("TCP connected");
 	set_fds();
+	pend_len = 0;
 	recv_cb = recv;
 	close_cb = close;
 
@@ -158,23 +169,68 @@ void tcp6_stop(void)
 	}
 }
 
+/* Send until done or socket is full. Returns amount of bytes sent */
+static ssize_t send_buf(const u8_t *buf, size_t len)
+{
+	size_t sent = 0;
+	ssize_t out_len;
+
+	while (sent < len) {
+		out_len = zsock_send(socket, buf + sent, len - sent,
+				     SEND_FLAGS);
+		if (out_len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -errno;
+		}
+
+		sent += out_len;
+	}
+
+	return sent;
+}
+
 int tcp6_send(const u8_t *buf, size_t len)
 {
-	ssize_t pend_len = len;
 	ssize_t out_len;
 
+	/* Previous message must be finished first */
+	if (pend_len)
+		return -EBUSY;
+
+	if (len > sizeof(pend_buf))
+		return -EMSGSIZE;
+
 	LOG_DBG("Sending msg");
-	while (pend_len) {
-		out_len = zsock_send(socket, buf, pend_len, 0);
+	out_len = send_buf(buf, len);
+	if (out_len < 0)
+		return out_len;
 
-		if (out_len < 0)
-			return -errno;
+	/* Remaining bytes are sent by tcp6_flush() */
+	pend_len = len - out_len;
+	memcpy(pend_buf, buf + out_len, pend_len);
+
+	return len;
+}
 
-		buf = buf + out_len;
-		pend_len -= out_len;
+int tcp6_flush(void)
+{
+	ssize_t out_len;
+
+	if (pend_len == 0)
+		return 0;
+
+	out_len = send_buf(pend_buf, pend_len);
+	if (out_len < 0) {
+		/* Drop message */
+		pend_len = 0;
+		return out_len;
 	}
 
-	return len;
+	pend_len -= out_len;
+	memmove(pend_buf, pend_buf + out_len, pend_len);
+
+	return pend_len;
 }
 
 int tcp6_init(void)
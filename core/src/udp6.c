@@ -22,6 +22,13 @@
 
 LOG_MODULE_DECLARE(knot, CONFIG_KNOT_LOG_LEVEL);
 
+/* Event loop can't wait for network buffers */
+#if CONFIG_KNOT_SINGLE_THREAD
+#define SEND_FLAGS	ZSOCK_MSG_DONTWAIT
+#else
+#define SEND_FLAGS	0
+#endif
+
 #define PEER_IPV6_PORT 8886
 #define IPV6_LEN	40
 
@@ -88,7 +95,7 @@ int udp6_send(const u8_t *buf, size_t len)
 
 	LOG_DBG("Sending msg");
 	while (pend_len) {
-		out_len = zsock_send(socket, buf, pend_len, 0);
+		out_len = zsock_send(socket, buf, pend_len, SEND_FLAGS);
 
 		if (out_len < 0)
 			return -errno;
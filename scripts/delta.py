@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019, CESAR. All rights reserved.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Generate and check differential firmware update patches.
+
+Patches rebuild a signed image (.bin) from the image running on the device
+and are uploaded with the KNoT delta mcumgr group. See setup/src/delta.c for
+the patch format.
+"""
+
+import hashlib
+import logging
+import struct
+import sys
+
+import click
+import coloredlogs
+
+MAGIC = 0x3146444b  # "KDF1"
+HDR_FMT = '<III32s32s'
+OP_FMT = '<BII'
+OP_COPY = 0
+OP_INSERT = 1
+
+BLOCK_LEN = 32  # Min length of a copied block
+
+
+def index_source(src):
+    """
+    Map every BLOCK_LEN bytes block of source to its first offset
+    """
+    index = {}
+    for off in range(len(src) - BLOCK_LEN + 1):
+        index.setdefault(src[off:off + BLOCK_LEN], off)
+    return index
+
+
+def diff(src, dst):
+    """
+    Greedy diff. Returns list of (op, offset, data)
+    """
+    index = index_source(src)
+    ops = []
+    literal_start = 0
+    pos = 0
+
+    while pos + BLOCK_LEN <= len(dst):
+        src_off = index.get(dst[pos:pos + BLOCK_LEN])
+        if src_off is None:
+            pos += 1
+            continue
+
+        # Extend match forward
+        length = BLOCK_LEN
+        while (pos + length < len(dst) and src_off + length < len(src) and
+               dst[pos + length] == src[src_off + length]):
+            length += 1
+
+        if literal_start < pos:
+            ops.append((OP_INSERT, 0, dst[literal_start:pos]))
+        ops.append((OP_COPY, src_off, length))
+
+        pos += length
+        literal_start = pos
+
+    if literal_start < len(dst):
+        ops.append((OP_INSERT, 0, dst[literal_start:]))
+
+    return ops
+
+
+def create_patch(src, dst):
+    """
+    Encode patch from source to target image
+    """
+    patch = bytearray(struct.pack(HDR_FMT, MAGIC, len(src), len(dst),
+                                  hashlib.sha256(src).digest(),
+                                  hashlib.sha256(dst).digest()))
+
+    for op, off, data in diff(src, dst):
+        if op == OP_COPY:
+            patch += struct.pack(OP_FMT, OP_COPY, data, off)
+        else:
+            patch += struct.pack(OP_FMT, OP_INSERT, len(data), 0)
+            patch += data
+
+    return bytes(patch)
+
+
+def apply_patch(src, patch):
+    """
+    Rebuild target image the same way the device does
+    """
+    hdr_len = struct.calcsize(HDR_FMT)
+    op_len = struct.calcsize(OP_FMT)
+
+    magic, src_len, dst_len, src_sha, dst_sha = struct.unpack_from(HDR_FMT,
+                                                                   patch)
+    if magic != MAGIC:
+        raise ValueError('Invalid patch magic')
+
+    if hashlib.sha256(src[:src_len]).digest() != src_sha:
+        raise ValueError('Patch does not match source image')
+
+    dst = bytearray()
+    pos = hdr_len
+    while len(dst) < dst_len:
+        op, length, off = struct.unpack_from(OP_FMT, patch, pos)
+        pos += op_len
+        if op == OP_COPY:
+            if off + length > src_len:
+                raise ValueError('Copy out of source bounds')
+            dst += src[off:off + length]
+        elif op == OP_INSERT:
+            dst += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError('Invalid op {}'.format(op))
+
+    if pos != len(patch) or len(dst) != dst_len:
+        raise ValueError('Invalid patch length')
+
+    if hashlib.sha256(dst).digest() != dst_sha:
+        raise ValueError('Rebuilt image hash mismatch')
+
+    return bytes(dst)
+
+
+def read_file(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+@click.group()
+def cli():
+    """
+    Differential firmware update patch tool
+    """
+
+
+@cli.command(help='Create patch from running image to new image')
+@click.argument('src')
+@click.argument('dst')
+@click.argument('output')
+def create(src, dst, output):
+    src_img = read_file(src)
+    dst_img = read_file(dst)
+
+    patch = create_patch(src_img, dst_img)
+
+    # Always check patch before using it
+    if apply_patch(src_img, patch) != dst_img:
+        sys.exit('Error: Generated patch does not rebuild target image')
+
+    with open(output, 'wb') as f:
+        f.write(patch)
+
+    logging.info('Patch generated at {} ({} bytes, {:.1f}% of image)'.format(
+        output, len(patch), 100.0 * len(patch) / len(dst_img)))
+
+
+@cli.command(help='Apply patch to image and check result')
+@click.argument('src')
+@click.argument('patch')
+@click.argument('output', required=False)
+def apply(src, patch, output):
+    try:
+        dst_img = apply_patch(read_file(src), read_file(patch))
+    except (ValueError, struct.error) as err:
+        sys.exit('Error: {}'.format(err))
+
+    if output:
+        with open(output, 'wb') as f:
+            f.write(dst_img)
+
+    logging.info('Patch applied successfully ({} bytes)'.format(len(dst_img)))
+
+
+if __name__ == '__main__':
+    """
+    Run cli
+    """
+    # Use logging
+    log_format = '%(asctime)s [%(levelname)s]: %(message)s'
+    coloredlogs.install(fmt=log_format)  # Enable colored logging
+
+    cli()  # Run command line interface
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019, CESAR. All rights reserved.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Local KNoT gateway stand-in for boot time benchmarks.
+
+Accepts the thing TCP connection and acknowledges every request with a
+successful response, so the thing gets to ONLINE state as fast as the
+device side allows. Registration is answered with fixed credentials.
+Time from each response to the next request is logged as the thing
+turnaround latency.
+"""
+
+import logging
+import socket
+import struct
+import time
+
+import click
+import coloredlogs
+
+PORT = 8886
+
+# Message types from knot_protocol.h. Responses are requests + 1
+KNOT_MSG_REG_REQ = 0x10
+
+UUID = b'0354ec44-826e-4269-8855-a666b1e40000'
+TOKEN = b'924c222bc1f2e7d8648b43fd8fada6b4152fa905'
+
+
+def response(msg_type):
+    """
+    Successful response for request msg_type
+    """
+    payload = struct.pack('b', 0)  # Result OK
+    if msg_type == KNOT_MSG_REG_REQ:
+        payload += UUID + TOKEN
+
+    return struct.pack('BB', msg_type + 1, len(payload)) + payload
+
+
+def serve(conn):
+    buf = b''
+    sent_time = None
+    while True:
+        data = conn.recv(256)
+        if not data:
+            return
+        recv_time = time.monotonic()
+        buf += data
+
+        # Header: type (1) and payload length (1)
+        while len(buf) >= 2 and len(buf) >= 2 + buf[1]:
+            msg_type = buf[0]
+            buf = buf[2 + buf[1]:]
+
+            # Only requests are answered
+            if msg_type % 2:
+                continue
+
+            if sent_time is None:
+                logging.info('Request 0x{:02x}'.format(msg_type))
+            else:
+                logging.info('Request 0x{:02x} after {:.1f} ms'.format(
+                    msg_type, (recv_time - sent_time) * 1000))
+
+            conn.sendall(response(msg_type))
+            sent_time = time.monotonic()
+
+
+@click.command(help='Run local gateway stand-in')
+@click.option('-p', '--port', default=PORT, help='TCP port to listen')
+def cli(port):
+    server = socket.socket(socket.AF_INET6, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(('::', port))
+    server.listen(1)
+    logging.info('Listening on port {}'.format(port))
+
+    while True:
+        conn, addr = server.accept()
+        logging.info('Thing connected from {}'.format(addr[0]))
+        with conn:
+            serve(conn)
+        logging.info('Thing disconnected')
+
+
+if __name__ == '__main__':
+    """
+    Run cli
+    """
+    # Use logging
+    log_format = '%(asctime)s [%(levelname)s]: %(message)s'
+    coloredlogs.install(fmt=log_format)  # Enable colored logging
+
+    cli()  # Run command line interface
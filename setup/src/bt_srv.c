@@ -34,69 +34,86 @@
 #include "bt_srv.h"
 #include "gatt_inet6.h"
 #include "gatt_ctrl.h"
+#include "gatt_prov.h"
+#include "delta.h"
 #include "clear.h"
 
 LOG_MODULE_DECLARE(knot_setup, LOG_LEVEL_DBG);
 
-#define ADVERTISING_TOGGLE_MS 500
+/*
+ * Connection parameters for bulk transfers (DFU and provisioning):
+ * 7.5 to 15 ms interval, no slave latency and 4 s supervision timeout.
+ */
+#define CONN_INTERVAL_MIN	6	/* N * 1.25 ms */
+#define CONN_INTERVAL_MAX	12	/* N * 1.25 ms */
+#define CONN_LATENCY		0
+#define CONN_TIMEOUT		400	/* N * 10 ms */
 
 bool active_conn;
+static struct k_work adv_work;		/* (Re)start advertising */
 
-/* Advertise Peer's IPV6 GATT service's UUID  */
-static const struct bt_data ad_inet6[] = {
+/*
+ * Legacy advertising fits a single 128-bit UUID per packet. Advertise
+ * Peer's IPV6 GATT service's UUID and reply scans with Peer's MCUMGR
+ * service's UUID (plus device name) so both are always discoverable.
+ * Control and OpenThread services are found through GATT discovery.
+ */
+static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
 	BT_DATA_BYTES(BT_DATA_UUID128_SOME,
 		      0x70, 0x14, 0x1c, 0xbe, 0xdd, 0xe6, 0x5a, 0xb3,
 		      0x8b, 0x49, 0xb4, 0x5d, 0x83, 0x11, 0x60, 0x49),
 };
 
-/* Advertise Peer's MCUMGR service's UUID  */
-static const struct bt_data ad_mcumgr[] = {
-	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+static const struct bt_data scan_resp[] = {
 	BT_DATA_BYTES(BT_DATA_UUID128_SOME,
 		      0x84, 0xaa, 0x60, 0x74, 0x52, 0x8a, 0x8b, 0x86,
 		      0xd3, 0x4c, 0xb7, 0x1d, 0x1d, 0xdc, 0x53, 0x8d),
 };
 
-/* Scan response Control device GATT service's UUID  */
-static const struct bt_data scan_resp_ctrl[] = {
-	BT_DATA_BYTES(BT_DATA_UUID128_SOME,
-		      0x70, 0xba, 0x2b, 0xfb, 0x05, 0x74, 0x4a, 0x64,
-		      0x9a, 0x93, 0xc8, 0x7c, 0xf3, 0x8f, 0x41, 0x81),
-};
-
-/* Scan respond OpenThread Settings GATT service's UUID */
-static const struct bt_data scan_resp_ot[] = {
-	BT_DATA_BYTES(BT_DATA_UUID128_SOME,
-		      0x30, 0x0d, 0x90, 0xb4, 0x7b, 0x81, 0xec, 0x9b,
-	              0x41, 0xd4, 0x9a, 0xaa, 0x9c, 0xe4, 0xa9, 0xa8),
-};
-
-static void advertise(const struct bt_data *adv,
-		      const struct bt_data *scan_resp)
+static void advertise(struct k_work *work)
 {
 	int err;
 
-	bt_le_adv_stop();
+	/* Advertising stops on connection and is restarted on disconnection */
+	if (active_conn)
+		return;
 
-	/* Using ad_inet6 as default size for all advertises */
-	/* Using scan_resp_ot as default size for all scan responses */
 	err = bt_le_adv_start(BT_LE_ADV_CONN_NAME,
-			      adv, ARRAY_SIZE(ad_inet6),
-			      scan_resp, ARRAY_SIZE(scan_resp_ot));
+			      ad, ARRAY_SIZE(ad),
+			      scan_resp, ARRAY_SIZE(scan_resp));
 	if (err) {
 		LOG_ERR("Advertising failed to start (err %d)", err);
 	}
 }
 
-static void connected(struct bt_conn *conn, u8_t err)
+/*
+ * PHY (2M) and data length (DLE) updates are started by the host on
+ * connection when supported by both sides. Only connection parameters
+ * need to be requested.
+ */
+static void request_fast_conn(struct bt_conn *conn)
 {
-	active_conn = true;
+	struct bt_le_conn_param *param = BT_LE_CONN_PARAM(CONN_INTERVAL_MIN,
+							  CONN_INTERVAL_MAX,
+							  CONN_LATENCY,
+							  CONN_TIMEOUT);
+	int err;
+
+	err = bt_conn_le_param_update(conn, param);
+	if (err)
+		LOG_WRN("Connection parameters request failed (err %d)", err);
+}
 
+static void connected(struct bt_conn *conn, u8_t err)
+{
 	if (err) {
 		LOG_ERR("Connection failed (err %u)", err);
+		k_work_submit(&adv_work);
 	} else {
+		active_conn = true;
 		LOG_DBG("Connected");
+		request_fast_conn(conn);
 	}
 }
 
@@ -104,11 +121,22 @@ static void disconnected(struct bt_conn *conn, u8_t reason)
 {
 	active_conn = false;
 	LOG_DBG("Disconnected (reason %u)", reason);
+
+	/* Connection object is released after this callback returns */
+	k_work_submit(&adv_work);
+}
+
+static void le_param_updated(struct bt_conn *conn, u16_t interval,
+			     u16_t latency, u16_t timeout)
+{
+	LOG_DBG("Connection parameters: interval %u latency %u timeout %u",
+		interval, latency, timeout);
 }
 
 static struct bt_conn_cb conn_callbacks = {
 	.connected = connected,
 	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
 };
 
 static void pairing_complete_cb(struct bt_conn *conn, bool bonded)
@@ -139,7 +167,7 @@ static void ot_updated(void)
 	}
 }
 
-int bt_srv_init(bool *reset_signal)
+int bt_srv_init(struct k_poll_signal *reset_signal)
 {
 	int err;
 
@@ -152,6 +180,13 @@ int bt_srv_init(bool *reset_signal)
 		return err;
 	}
 
+	/* Bulk provisioning GATT service */
+	err = gatt_prov_init();
+	if (err) {
+		LOG_ERR("Provisioning GATT service init failed (err %d)", err);
+		return err;
+	}
+
 	/* Control device GATT service */
 	err = gatt_ctrl_init(reset_signal);
 	if (err) {
@@ -166,6 +201,9 @@ int bt_srv_init(bool *reset_signal)
 #ifdef CONFIG_MCUMGR_CMD_IMG_MGMT
 	img_mgmt_register_group();
 #endif
+#if CONFIG_KNOT_DELTA_DFU
+	delta_mgmt_register_group();
+#endif
 
 	err = bt_enable(NULL);
 	if (err) {
@@ -187,31 +225,8 @@ int bt_srv_init(bool *reset_signal)
 	return 0;
 }
 
-/* Alternate advertising if not connected */
-void bt_srv_toggle_advertising(void)
+void bt_srv_start_advertising(void)
 {
-	const struct bt_data *adv_tmp;
-	const struct bt_data *scan_resp_tmp;
-	static s64_t last_toggle_time = 0;
-	s64_t current_time;
-	static bool adv_bool = false;
-
-	/* Ignore if connected */
-	if (active_conn)
-		return;
-
-	/* Wait for toggle time */
-	current_time = k_uptime_get();
-	if (current_time - last_toggle_time < ADVERTISING_TOGGLE_MS)
-		return;
-
-	/* Toggle advertising arrays */
-	adv_tmp = (adv_bool) ? ad_inet6 : ad_mcumgr;
-	scan_resp_tmp = (adv_bool) ? scan_resp_ot : scan_resp_ctrl;
-
-	advertise(adv_tmp, scan_resp_tmp);
-	adv_bool = !adv_bool;
-
-	/* Update time */
-	last_toggle_time = current_time;
+	k_work_init(&adv_work, advertise);
+	k_work_submit(&adv_work);
 }
@@ -15,6 +15,6 @@
  * limitations under the License.
  */
 
-int bt_srv_init(bool *reset_signal);
+int bt_srv_init(struct k_poll_signal *reset_signal);
 
-void bt_srv_toggle_advertising(void);
+void bt_srv_start_advertising(void);
@@ -0,0 +1,437 @@
+/* delta.c - Differential firmware update over mcumgr */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Patches are generated by scripts/delta.py against the image running at
+ * slot 0. The new image is rebuilt while the patch is received and written
+ * to slot 1. Both source and result are checked by SHA-256 before asking
+ * MCUboot for the swap.
+ *
+ * Patch format (little endian):
+ *	header:	magic (4), source size (4), target size (4),
+ *		source SHA-256 (32), target SHA-256 (32)
+ *	ops:	op (1), length (4), source offset (4), [data]
+ *		DELTA_OP_COPY copies length bytes from source offset.
+ *		DELTA_OP_INSERT is followed by length bytes of data.
+ */
+
+#if CONFIG_KNOT_DELTA_DFU
+#include <zephyr.h>
+#include <limits.h>
+#include <logging/log.h>
+#include <misc/byteorder.h>
+#include <flash_map.h>
+#include <dfu/flash_img.h>
+#include <dfu/mcuboot.h>
+#include <tinycrypt/sha256.h>
+#include <tinycrypt/constants.h>
+
+#if CONFIG_MCUMGR
+#include <mgmt/mgmt.h>
+#include <cborattr/cborattr.h>
+#endif
+
+#include "delta.h"
+
+LOG_MODULE_DECLARE(knot_setup, LOG_LEVEL_DBG);
+
+#define DELTA_MAGIC		0x3146444b	/* "KDF1" */
+#define DELTA_HDR_LEN		76
+#define DELTA_OP_LEN		9
+#define DELTA_READ_LEN		64
+
+#define DELTA_MGMT_ID_UPLOAD	0
+#define DELTA_CHUNK_MAX		512
+
+enum {
+	DELTA_OP_COPY = 0,
+	DELTA_OP_INSERT,
+};
+
+enum {
+	STATE_HDR = 0,		/* Receiving header */
+	STATE_OP,		/* Receiving op */
+	STATE_INSERT,		/* Receiving insert data */
+	STATE_DONE,		/* Target fully written */
+};
+
+static struct {
+	u8_t state;
+	u8_t hdr[DELTA_HDR_LEN];	/* Header or op being received */
+	u16_t hdr_len;
+	u32_t src_size;
+	u32_t dst_size;
+	u32_t dst_written;
+	u32_t insert_left;
+	u32_t received;			/* Patch bytes received */
+	s64_t start_time;
+	u8_t dst_sha[TC_SHA256_DIGEST_SIZE];
+	const struct flash_area *src;
+	struct flash_img_context img;
+} delta;
+
+/* Hash len bytes of flash area */
+static int hash_area(u8_t area_id, u32_t len, u8_t *digest)
+{
+	const struct flash_area *fa;
+	struct tc_sha256_state_struct sha;
+	u8_t buf[DELTA_READ_LEN];
+	u32_t off;
+	u32_t chunk;
+	int rc;
+
+	rc = flash_area_open(area_id, &fa);
+	if (rc)
+		return rc;
+
+	if (len > fa->fa_size) {
+		rc = -EINVAL;
+		goto done;
+	}
+
+	tc_sha256_init(&sha);
+	for (off = 0; off < len; off += chunk) {
+		chunk = MIN(sizeof(buf), len - off);
+		rc = flash_area_read(fa, off, buf, chunk);
+		if (rc)
+			goto done;
+		tc_sha256_update(&sha, buf, chunk);
+	}
+	tc_sha256_final(digest, &sha);
+
+done:
+	flash_area_close(fa);
+
+	return rc;
+}
+
+static int write_target(const u8_t *data, u32_t len)
+{
+	int rc;
+
+	if (len > delta.dst_size - delta.dst_written)
+		return -EINVAL;
+
+	delta.dst_written += len;
+	rc = flash_img_buffered_write(&delta.img, (u8_t *) data, len,
+				      delta.dst_written == delta.dst_size);
+	if (rc)
+		return rc;
+
+	if (delta.dst_written == delta.dst_size)
+		delta.state = STATE_DONE;
+
+	return 0;
+}
+
+static int copy_source(u32_t off, u32_t len)
+{
+	u8_t buf[DELTA_READ_LEN];
+	u32_t chunk;
+	int rc;
+
+	if (off > delta.src_size || len > delta.src_size - off)
+		return -EINVAL;
+
+	for (; len; len -= chunk, off += chunk) {
+		chunk = MIN(sizeof(buf), len);
+		rc = flash_area_read(delta.src, off, buf, chunk);
+		if (rc)
+			return rc;
+
+		rc = write_target(buf, chunk);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int parse_hdr(void)
+{
+	u8_t digest[TC_SHA256_DIGEST_SIZE];
+	int rc;
+
+	if (sys_get_le32(&delta.hdr[0]) != DELTA_MAGIC)
+		return -EINVAL;
+
+	delta.src_size = sys_get_le32(&delta.hdr[4]);
+	delta.dst_size = sys_get_le32(&delta.hdr[8]);
+	if (delta.src_size > delta.src->fa_size || delta.dst_size == 0)
+		return -EINVAL;
+
+	/* Patch only applies to the image it was generated from */
+	rc = hash_area(DT_FLASH_AREA_IMAGE_0_ID, delta.src_size, digest);
+	if (rc)
+		return rc;
+
+	if (memcmp(digest, &delta.hdr[12], sizeof(digest))) {
+		LOG_ERR("Patch does not match running image");
+		return -EINVAL;
+	}
+
+	/* Header buffer is reused for ops */
+	memcpy(delta.dst_sha, &delta.hdr[44], sizeof(delta.dst_sha));
+	delta.state = STATE_OP;
+
+	return 0;
+}
+
+static int parse_op(void)
+{
+	u8_t op = delta.hdr[0];
+	u32_t len = sys_get_le32(&delta.hdr[1]);
+	u32_t off = sys_get_le32(&delta.hdr[5]);
+
+	switch (op) {
+	case DELTA_OP_COPY:
+		return copy_source(off, len);
+	case DELTA_OP_INSERT:
+		if (len == 0)
+			return -EINVAL;
+		delta.insert_left = len;
+		delta.state = STATE_INSERT;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+int delta_start(void)
+{
+	int rc;
+
+	if (delta.src)
+		flash_area_close(delta.src);
+
+	memset(&delta, 0, sizeof(delta));
+	delta.start_time = k_uptime_get();
+
+	rc = flash_area_open(DT_FLASH_AREA_IMAGE_0_ID, &delta.src);
+	if (rc)
+		return rc;
+
+	/* Target is written once: slot 1 may hold a previous image */
+	rc = boot_erase_img_bank(DT_FLASH_AREA_IMAGE_1_ID);
+	if (rc) {
+		LOG_ERR("Failed to erase slot 1 (err %d)", rc);
+		return rc;
+	}
+
+	return flash_img_init(&delta.img);
+}
+
+int delta_write(const u8_t *data, size_t len)
+{
+	u32_t chunk;
+	u16_t need;
+	int rc;
+
+	delta.received += len;
+
+	while (len) {
+		switch (delta.state) {
+		case STATE_HDR:
+		case STATE_OP:
+			need = (delta.state == STATE_HDR) ?
+				DELTA_HDR_LEN : DELTA_OP_LEN;
+			chunk = MIN(len, need - delta.hdr_len);
+			memcpy(&delta.hdr[delta.hdr_len], data, chunk);
+			delta.hdr_len += chunk;
+			if (delta.hdr_len < need)
+				break;
+
+			delta.hdr_len = 0;
+			rc = (delta.state == STATE_HDR) ? parse_hdr() :
+							  parse_op();
+			if (rc)
+				return rc;
+			break;
+		case STATE_INSERT:
+			chunk = MIN(len, delta.insert_left);
+			rc = write_target(data, chunk);
+			if (rc)
+				return rc;
+
+			delta.insert_left -= chunk;
+			if (delta.insert_left == 0 && delta.state != STATE_DONE)
+				delta.state = STATE_OP;
+			break;
+		default:
+			/* Trailing data after target is complete */
+			return -EINVAL;
+		}
+
+		data += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+int delta_finish(void)
+{
+	u8_t digest[TC_SHA256_DIGEST_SIZE];
+	u32_t elapsed;
+	int rc;
+
+	if (delta.state != STATE_DONE)
+		return -EINVAL;
+
+	/* Transfer throughput, including writes to slot 1 */
+	elapsed = k_uptime_get() - delta.start_time;
+	LOG_INF("Patch of %u bytes received in %u ms (%u B/s)",
+		delta.received, elapsed,
+		(u32_t) ((u64_t) delta.received * 1000 / (elapsed ? : 1)));
+
+	flash_area_close(delta.src);
+	delta.src = NULL;
+
+	/* Check rebuilt image before swapping */
+	rc = hash_area(DT_FLASH_AREA_IMAGE_1_ID, delta.dst_size, digest);
+	if (rc)
+		return rc;
+
+	if (memcmp(digest, delta.dst_sha, sizeof(digest))) {
+		LOG_ERR("Rebuilt image hash mismatch");
+		return -EINVAL;
+	}
+
+	LOG_INF("Delta update applied (%u bytes)", delta.dst_size);
+
+	return boot_request_upgrade(BOOT_UPGRADE_TEST);
+}
+
+void delta_abort(void)
+{
+	int rc;
+
+	if (delta.src) {
+		flash_area_close(delta.src);
+		delta.src = NULL;
+	}
+
+	delta.state = STATE_HDR;
+
+	/* Don't leave a partial image behind */
+	rc = boot_erase_img_bank(DT_FLASH_AREA_IMAGE_1_ID);
+	if (rc)
+		LOG_ERR("Failed to erase slot 1 (err %d)", rc);
+}
+
+#if CONFIG_MCUMGR
+/*
+ * mcumgr upload command. Same semantics as image upload: "len" is sent
+ * with the first chunk and "off" is the offset of "data" on the patch.
+ */
+static int delta_mgmt_upload(struct mgmt_ctxt *ctxt)
+{
+	static u8_t data[DELTA_CHUNK_MAX];
+	static size_t patch_len;
+	static size_t patch_off;
+	unsigned long long off = ULLONG_MAX;
+	unsigned long long len = ULLONG_MAX;
+	size_t data_len = 0;
+	CborError err;
+	int rc;
+
+	const struct cbor_attr_t attrs[] = {
+		{
+			.attribute = "off",
+			.type = CborAttrUnsignedIntegerType,
+			.addr.uinteger = &off,
+			.nodefault = true
+		},
+		{
+			.attribute = "len",
+			.type = CborAttrUnsignedIntegerType,
+			.addr.uinteger = &len,
+			.nodefault = true
+		},
+		{
+			.attribute = "data",
+			.type = CborAttrByteStringType,
+			.addr.bytestring.data = data,
+			.addr.bytestring.len = &data_len,
+			.len = sizeof(data)
+		},
+		{ 0 },
+	};
+
+	rc = cbor_read_object(&ctxt->it, attrs);
+	if (rc || off == ULLONG_MAX)
+		return MGMT_ERR_EINVAL;
+
+	if (off == 0) {
+		if (len == ULLONG_MAX || len < DELTA_HDR_LEN)
+			return MGMT_ERR_EINVAL;
+
+		rc = delta_start();
+		if (rc) {
+			delta_abort();
+			return MGMT_ERR_EUNKNOWN;
+		}
+
+		patch_len = len;
+		patch_off = 0;
+	}
+
+	/* Ignore out of order chunk and report expected offset */
+	if (off != patch_off || patch_len == 0)
+		goto done;
+
+	if (data_len > patch_len - patch_off)
+		return MGMT_ERR_EINVAL;
+
+	rc = delta_write(data, data_len);
+	if (rc) {
+		LOG_ERR("Invalid patch (err %d)", rc);
+		delta_abort();
+		patch_len = 0;
+		return MGMT_ERR_EINVAL;
+	}
+
+	patch_off += data_len;
+	if (patch_off == patch_len) {
+		rc = delta_finish();
+		patch_len = 0;
+		if (rc) {
+			LOG_ERR("Delta update failed (err %d)", rc);
+			delta_abort();
+			return MGMT_ERR_EBADSTATE;
+		}
+	}
+
+done:
+	err = cbor_encode_text_stringz(&ctxt->encoder, "rc");
+	err |= cbor_encode_int(&ctxt->encoder, MGMT_ERR_EOK);
+	err |= cbor_encode_text_stringz(&ctxt->encoder, "off");
+	err |= cbor_encode_uint(&ctxt->encoder, patch_off);
+
+	return (err) ? MGMT_ERR_ENOMEM : 0;
+}
+
+static const struct mgmt_handler delta_mgmt_handlers[] = {
+	[DELTA_MGMT_ID_UPLOAD] = {
+		.mh_read = NULL,
+		.mh_write = delta_mgmt_upload,
+	},
+};
+
+static struct mgmt_group delta_mgmt_group = {
+	.mg_handlers = delta_mgmt_handlers,
+	.mg_handlers_count = ARRAY_SIZE(delta_mgmt_handlers),
+	.mg_group_id = MGMT_GROUP_ID_PERUSER,
+};
+
+void delta_mgmt_register_group(void)
+{
+	mgmt_register_group(&delta_mgmt_group);
+}
+#endif /* CONFIG_MCUMGR */
+#endif
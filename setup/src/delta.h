@@ -0,0 +1,14 @@
+/* delta.h - Differential firmware update over mcumgr */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+int delta_start(void);
+int delta_write(const u8_t *data, size_t len);
+int delta_finish(void);
+void delta_abort(void);
+
+void delta_mgmt_register_group(void);
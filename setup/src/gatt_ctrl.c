@@ -23,7 +23,7 @@ enum {
 };
 
 static u8_t cmd = CTRL_CMD_UNSET;	// Received command
-static bool *out_reset_signal;
+static struct k_poll_signal *out_reset_signal;
 
 /* Custom Service Variables */
 static struct bt_uuid_128 service_uuid = BT_UUID_INIT_128(
@@ -36,7 +36,7 @@ static const struct bt_uuid_128 cmd_uuid = BT_UUID_INIT_128(
 static void process_cmd()
 {
 	if (cmd == CTRL_CMD_RESET)
-		*out_reset_signal = true;
+		k_poll_signal_raise(out_reset_signal, CTRL_CMD_RESET);
 }
 
 /* Write characteristic callback function */
@@ -72,7 +72,7 @@ static struct bt_gatt_attr config_gatt_attrs[] = {
 
 static struct bt_gatt_service config_svc = BT_GATT_SERVICE(config_gatt_attrs);
 
-int gatt_ctrl_init(bool *reset_signal)
+int gatt_ctrl_init(struct k_poll_signal *reset_signal)
 {
 	int err;
 
@@ -6,4 +6,4 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-int gatt_ctrl_init(bool *reset_signal);
+int gatt_ctrl_init(struct k_poll_signal *reset_signal);
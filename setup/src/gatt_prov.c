@@ -0,0 +1,327 @@
+/* gatt_prov.c - Callbacks and definition for bulk provisioning GATT service */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * All provisioning values are sent in a single characteristic write as a
+ * sequence of TLV entries (1 byte type, 1 byte length, value). The whole
+ * blob is validated before any value is stored. KNoT values are staged
+ * first and saved to flash in a single storage flush after the OpenThread
+ * dataset is written. If any step fails, all sets present on the blob are
+ * cleared, so none is left half written.
+ */
+
+#include <zephyr.h>
+#include <logging/log.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/gatt.h>
+#include <settings/settings_ot.h>
+
+#include "gatt_prov.h"
+#include "storage.h"
+#include "clear.h"
+
+/* Buffer lens */
+#define PROV_BLOB_LEN		320
+#define PEER_IPV6_LEN		40
+#define NET_NAME_LEN		17
+#define XPANID_LEN		24
+#define MASTERKEY_LEN		48
+#define UUID_LEN		36
+#define TOKEN_LEN		40
+
+LOG_MODULE_DECLARE(knot_setup, LOG_LEVEL_DBG);
+
+/* TLV types */
+enum {
+	PROV_TYPE_PEER_IPV6 = 0x01,
+	PROV_TYPE_OT_PANID,
+	PROV_TYPE_OT_CHANNEL,
+	PROV_TYPE_OT_NET_NAME,
+	PROV_TYPE_OT_XPANID,
+	PROV_TYPE_OT_MASTERKEY,
+	PROV_TYPE_KNOT_UUID,
+	PROV_TYPE_KNOT_TOKEN,
+	PROV_TYPE_KNOT_DEVID,
+	PROV_TYPE_MAX
+};
+
+/* Values are null terminated strings unless exact length is required */
+static const struct {
+	u8_t max_len;		/* Value max length */
+	bool exact;		/* Value must have max_len bytes */
+} prov_fmt[PROV_TYPE_MAX] = {
+	[PROV_TYPE_PEER_IPV6]		= { PEER_IPV6_LEN - 1,	false },
+	[PROV_TYPE_OT_PANID]		= { sizeof(u16_t),	true },
+	[PROV_TYPE_OT_CHANNEL]		= { sizeof(u8_t),	true },
+	[PROV_TYPE_OT_NET_NAME]		= { NET_NAME_LEN - 1,	false },
+	[PROV_TYPE_OT_XPANID]		= { XPANID_LEN - 1,	false },
+	[PROV_TYPE_OT_MASTERKEY]	= { MASTERKEY_LEN - 1,	false },
+	[PROV_TYPE_KNOT_UUID]		= { UUID_LEN,		true },
+	[PROV_TYPE_KNOT_TOKEN]		= { TOKEN_LEN,		true },
+	[PROV_TYPE_KNOT_DEVID]		= { sizeof(u64_t),	true },
+};
+
+/* Values parsed from blob */
+static struct {
+	u16_t present;		/* Bitmask of received types */
+	char peer_ipv6[PEER_IPV6_LEN];
+	u16_t panid;
+	u8_t channel;
+	char net_name[NET_NAME_LEN];
+	char xpanid[XPANID_LEN];
+	char masterkey[MASTERKEY_LEN];
+	char uuid[UUID_LEN];
+	char token[TOKEN_LEN];
+	u64_t devid;
+} prov;
+
+static void *prov_value[PROV_TYPE_MAX] = {
+	[PROV_TYPE_PEER_IPV6]		= prov.peer_ipv6,
+	[PROV_TYPE_OT_PANID]		= &prov.panid,
+	[PROV_TYPE_OT_CHANNEL]		= &prov.channel,
+	[PROV_TYPE_OT_NET_NAME]		= prov.net_name,
+	[PROV_TYPE_OT_XPANID]		= prov.xpanid,
+	[PROV_TYPE_OT_MASTERKEY]	= prov.masterkey,
+	[PROV_TYPE_KNOT_UUID]		= prov.uuid,
+	[PROV_TYPE_KNOT_TOKEN]		= prov.token,
+	[PROV_TYPE_KNOT_DEVID]		= &prov.devid,
+};
+
+#define PRESENT(type)		(prov.present & BIT(type))
+
+#define OT_TYPES_MASK		(BIT(PROV_TYPE_OT_PANID) | \
+				 BIT(PROV_TYPE_OT_CHANNEL) | \
+				 BIT(PROV_TYPE_OT_NET_NAME) | \
+				 BIT(PROV_TYPE_OT_XPANID) | \
+				 BIT(PROV_TYPE_OT_MASTERKEY))
+#define KNOT_TYPES_MASK		(BIT(PROV_TYPE_KNOT_UUID) | \
+				 BIT(PROV_TYPE_KNOT_TOKEN) | \
+				 BIT(PROV_TYPE_KNOT_DEVID))
+
+/* Custom Service Variables */
+static struct bt_uuid_128 prov_service_uuid = BT_UUID_INIT_128(
+	0x72, 0x14, 0x1c, 0xbe, 0xdd, 0xe6, 0x5a, 0xb3,
+	0x8b, 0x49, 0xb4, 0x5d, 0x83, 0x11, 0x60, 0x49);
+static const struct bt_uuid_128 prov_blob_uuid = BT_UUID_INIT_128(
+	0x73, 0x14, 0x1c, 0xbe, 0xdd, 0xe6, 0x5a, 0xb3,
+	0x8b, 0x49, 0xb4, 0x5d, 0x83, 0x11, 0x60, 0x49);
+
+/* Parse and validate whole blob. Nothing is stored on failure */
+static int parse_blob(const u8_t *blob, u16_t len)
+{
+	u16_t i;
+	u8_t type;
+	u8_t vlen = 0;
+
+	memset(&prov, 0, sizeof(prov));
+
+	for (i = 0; i < len; i += 2 + vlen) {
+		if (len - i < 2)
+			return -EINVAL;
+
+		type = blob[i];
+		vlen = blob[i + 1];
+
+		if (type == 0 || type >= PROV_TYPE_MAX) {
+			LOG_ERR("Invalid provisioning type %u", type);
+			return -EINVAL;
+		}
+
+		if (PRESENT(type)) {
+			LOG_ERR("Duplicated provisioning type %u", type);
+			return -EINVAL;
+		}
+
+		if (len - i - 2 < vlen || vlen == 0 ||
+		    vlen > prov_fmt[type].max_len ||
+		    (prov_fmt[type].exact && vlen != prov_fmt[type].max_len)) {
+			LOG_ERR("Invalid length %u for type %u", vlen, type);
+			return -EINVAL;
+		}
+
+		memcpy(prov_value[type], &blob[i + 2], vlen);
+		prov.present |= BIT(type);
+	}
+
+	/* OpenThread and KNoT values are only accepted as complete sets */
+	if ((prov.present & OT_TYPES_MASK) &&
+	    (prov.present & OT_TYPES_MASK) != OT_TYPES_MASK) {
+		LOG_ERR("Incomplete OpenThread dataset");
+		return -EINVAL;
+	}
+
+	if ((prov.present & KNOT_TYPES_MASK) &&
+	    (prov.present & KNOT_TYPES_MASK) != KNOT_TYPES_MASK) {
+		LOG_ERR("Incomplete KNoT credentials");
+		return -EINVAL;
+	}
+
+	return (prov.present) ? 0 : -EINVAL;
+}
+
+static int store_ot(void)
+{
+	int rc;
+
+	/* Old OpenThread state must not be used with new dataset */
+	rc = clear_ot_nvs();
+	if (rc)
+		return rc;
+
+	rc = settings_ot_write(SETTINGS_OT_PANID, &prov.panid);
+	if (rc)
+		return rc;
+
+	rc = settings_ot_write(SETTINGS_OT_CHANNEL, &prov.channel);
+	if (rc)
+		return rc;
+
+	rc = settings_ot_write(SETTINGS_OT_NET_NAME, prov.net_name);
+	if (rc)
+		return rc;
+
+	rc = settings_ot_write(SETTINGS_OT_XPANID, prov.xpanid);
+	if (rc)
+		return rc;
+
+	return settings_ot_write(SETTINGS_OT_MASTERKEY, prov.masterkey);
+}
+
+/* Saved to flash by storage_flush() with write-behind enabled */
+static int stage_knot(void)
+{
+	int rc;
+
+	if (PRESENT(PROV_TYPE_PEER_IPV6)) {
+		rc = storage_write(STORAGE_PEER_IPV6, prov.peer_ipv6,
+				   sizeof(prov.peer_ipv6));
+		if (rc != sizeof(prov.peer_ipv6))
+			return -EIO;
+	}
+
+	if ((prov.present & KNOT_TYPES_MASK) == 0)
+		goto done;
+
+	rc = storage_write(STORAGE_CRED_UUID, prov.uuid, sizeof(prov.uuid));
+	if (rc != sizeof(prov.uuid))
+		return -EIO;
+
+	rc = storage_write(STORAGE_CRED_TOKEN, prov.token, sizeof(prov.token));
+	if (rc != sizeof(prov.token))
+		return -EIO;
+
+	rc = storage_write(STORAGE_CRED_DEVID, &prov.devid,
+			   sizeof(prov.devid));
+	if (rc != sizeof(prov.devid))
+		return -EIO;
+
+done:
+	return 0;
+}
+
+static int store_prov(void)
+{
+	int rc;
+
+	rc = stage_knot();
+	if (rc)
+		return rc;
+
+	if (prov.present & OT_TYPES_MASK) {
+		rc = store_ot();
+		if (rc)
+			return rc;
+	}
+
+	/* Save all KNoT values in a row */
+	return storage_flush();
+}
+
+/* Forget sets present on blob after a failed store */
+static void clear_prov(void)
+{
+	if (prov.present & OT_TYPES_MASK) {
+		if (settings_ot_reset() || clear_ot_nvs())
+			LOG_ERR("Failed to clear OpenThread dataset");
+	}
+
+	if (PRESENT(PROV_TYPE_PEER_IPV6))
+		storage_clear(STORAGE_PEER_IPV6);
+
+	if (prov.present & KNOT_TYPES_MASK) {
+		storage_clear(STORAGE_CRED_UUID);
+		storage_clear(STORAGE_CRED_TOKEN);
+		storage_clear(STORAGE_CRED_DEVID);
+	}
+}
+
+/* Write characteristic callback function */
+static ssize_t write_blob(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			  const void *buf, u16_t len, u16_t offset, u8_t flags)
+{
+	static u8_t blob[PROV_BLOB_LEN];	// Blob build buffer
+	static u16_t blob_len;
+	int rc;
+
+	if (offset + len > sizeof(blob))
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+
+	if (offset == 0)
+		blob_len = 0;
+
+	memcpy(blob + offset, buf, len);
+	if (offset + len > blob_len)
+		blob_len = offset + len;
+
+	/* Check for prepare write flag */
+	if (flags & BT_GATT_WRITE_FLAG_PREPARE)
+		return 0;
+
+	rc = parse_blob(blob, blob_len);
+	if (rc)
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+
+	rc = store_prov();
+	if (rc) {
+		LOG_ERR("Failed to store provisioning values (err %d)", rc);
+		clear_prov();
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	LOG_INF("Provisioning values stored");
+
+	return len;
+}
+
+/* Provisioning GATT Service Declaration */
+static struct bt_gatt_attr prov_gatt_attrs[] = {
+	/* Vendor Primary Service Declaration */
+	BT_GATT_PRIMARY_SERVICE(&prov_service_uuid),
+	BT_GATT_CHARACTERISTIC(&prov_blob_uuid.uuid,
+			       BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_WRITE |
+			       BT_GATT_PERM_PREPARE_WRITE,
+			       NULL, write_blob, NULL),
+};
+
+static struct bt_gatt_service prov_svc = BT_GATT_SERVICE(prov_gatt_attrs);
+
+int gatt_prov_init(void)
+{
+	int err;
+
+	/* GATT service start */
+	err = bt_gatt_service_register(&prov_svc);
+	if (err) {
+		LOG_ERR("GATT service init failed (err %d)", err);
+		return err;
+	}
+
+	return 0;
+}
@@ -0,0 +1,9 @@
+/* gatt_prov.h - Callbacks and definition for bulk provisioning GATT service */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+int gatt_prov_init(void);
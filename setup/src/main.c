@@ -26,6 +26,7 @@
 #include "bootloader.h"
 #include "storage.h"
 #include "ot_config.h"
+#include "retained.h"
 
 LOG_MODULE_REGISTER(knot_setup, LOG_LEVEL_DBG);
 
@@ -35,7 +36,23 @@ void main(void)
 	int btn;
 	bool ipv6_set;
 	bool ot_set;
-	bool reset_signal = false;  // Avoid early reseting
+	struct k_poll_signal reset_signal;
+	struct k_poll_event reset_evt = K_POLL_EVENT_INITIALIZER(
+					K_POLL_TYPE_SIGNAL,
+					K_POLL_MODE_NOTIFY_ONLY,
+					&reset_signal);
+
+	/* Jump to main application if already checked on previous boot */
+	err = peripheral_init();
+	if (err)
+		LOG_ERR("Peripheral initialization failed");
+
+	if (retained_is_provisioned() &&
+	    peripheral_btn_status() == PERIPHERAL_BTN_NOT_PRESSED)
+		goto main_app;
+
+	/* Settings must be checked again if setup is entered */
+	retained_set_provisioned(false);
 
 	LOG_DBG("Initializing storage services");
 
@@ -67,10 +84,7 @@ void main(void)
 	err = ot_config_load();
 	ot_set = (err == 0); /* OT config loaded. Has OT settings */
 
-	/* Jump to main application if button pressed */
-	err = peripheral_init();
-	if (err)
-		LOG_ERR("Peripheral initialization failed");
+	/* Run setup application if button pressed */
 	btn = peripheral_btn_status();
 
 	switch (btn) {
@@ -93,6 +107,10 @@ void main(void)
 	    ipv6_set == false || ot_set == false)
 		goto setup;
 
+	/* Skip settings check on next warm boots */
+	retained_set_provisioned(true);
+
+main_app:
 	/* Load Main App */
 	err = bootloader_start_main();
 	if (err == false) /* Successful load */
@@ -109,22 +127,26 @@ setup:
 	LOG_DBG("Initializing Setup App");
 
 	/* Init bluetooth services and give access to signal flags */
+	k_poll_signal_init(&reset_signal);
 	err = bt_srv_init(&reset_signal);
 	if (err) {
 		LOG_ERR("Failed to initialize bluetooth");
 		return;
 	}
 
-	while (1) {
-		bt_srv_toggle_advertising();
-		peripheral_toggle_led();
+	/* Advertising and LEDs run from timers. Idle until reset */
+	bt_srv_start_advertising();
+	peripheral_start_led_blink();
 
-		/* Reset system if signal received */
-		if (reset_signal == false)
-			continue;
+	k_poll(&reset_evt, 1, K_FOREVER);
 
-		LOG_INF("Reseting system...");
-		k_sleep(2000);
-		sys_reboot(SYS_REBOOT_WARM);
-	}
+	/* Reset system if signal received */
+	LOG_INF("Reseting system...");
+	/* Make sure provisioned values are on flash */
+	err = storage_flush();
+	if (err)
+		LOG_ERR("Storage flush failed (err %d)", err);
+
+	k_sleep(2000);
+	sys_reboot(SYS_REBOOT_WARM);
 }
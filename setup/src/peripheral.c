@@ -117,23 +117,23 @@ int peripheral_btn_status(void)
 	return val;
 }
 
-void peripheral_toggle_led(void)
+static void toggle_led(struct k_timer *timer_id)
 {
-	static s64_t last_toggle_time = 0;
-	s64_t current_time;
 	static bool led_state = false;
 
-	/* Wait for toggle time */
-	current_time = k_uptime_get();
-	if (current_time - last_toggle_time < LED_TOGGLE_PERIOD)
-		return;
-
 	/* Toggle led */
 	gpio_pin_write(gpio_led_dev[0], gpio_led_pin[0],  led_state);
 	gpio_pin_write(gpio_led_dev[1], gpio_led_pin[1], !led_state);
 
 	led_state = !led_state;
+}
+
+K_TIMER_DEFINE(led_timer, toggle_led, NULL);
 
-	/* Update time */
-	last_toggle_time = current_time;
+/*
+ * Blink LEDs alternately from timer. No need to be called periodically.
+ */
+void peripheral_start_led_blink(void)
+{
+	k_timer_start(&led_timer, 0, LED_TOGGLE_PERIOD);
 }
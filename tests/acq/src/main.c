@@ -0,0 +1,165 @@
+/* main.c - Continuous ADC acquisition tests */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * A fake ADC driver keeps the sequence started by acq.c. Tests write
+ * synthetic samples to the sequence buffer and call its callback as the
+ * ADC ISR would, checking the values published to proxies.
+ */
+
+#include <ztest.h>
+#include <logging/log.h>
+#include <device.h>
+#include <adc.h>
+
+#include "knot.h"
+
+LOG_MODULE_REGISTER(knot, CONFIG_KNOT_LOG_LEVEL);
+
+#define INTERVAL_US	1000
+#define DECIMATION	4
+
+/* Proxies are only compared, never dereferenced */
+static int proxy_objs[2];
+#define PROXY(n)	((struct knot_proxy *) &proxy_objs[n])
+
+static s32_t published[2];
+static int publish_count;
+static int wakeup_count;
+
+static const struct adc_sequence *sequence;
+
+bool knot_proxy_value_complete_q16(struct knot_proxy *proxy, s32_t value)
+{
+	published[proxy == PROXY(1)] = value;
+	publish_count++;
+
+	return true;
+}
+
+void knot_app_wakeup(void)
+{
+	wakeup_count++;
+}
+
+static int fake_read_async(struct device *dev,
+			   const struct adc_sequence *seq,
+			   struct k_poll_signal *async)
+{
+	sequence = seq;
+
+	return 0;
+}
+
+static const struct adc_driver_api fake_adc_api = {
+	.read_async = fake_read_async,
+};
+
+static struct device fake_adc = {
+	.driver_api = &fake_adc_api,
+};
+
+/* One sampling of both channels, ordered by channel id */
+static enum adc_action sample(s16_t ch0, s16_t ch1)
+{
+	s16_t *buf = sequence->buffer;
+
+	buf[0] = ch0;
+	buf[1] = ch1;
+
+	return sequence->options->callback(&fake_adc, sequence, 0);
+}
+
+static void test_start(void)
+{
+	s32_t value;
+
+	/* Added out of order: samples come ordered by channel id */
+	zassert_equal(knot_acq_add_channel(3, PROXY(1), KNOT_Q16(0.5)), 0,
+		      "Channel 3 not added");
+	zassert_equal(knot_acq_add_channel(1, PROXY(0), KNOT_Q16(1)), 0,
+		      "Channel 1 not added");
+	zassert_equal(knot_acq_add_channel(2, PROXY(0), KNOT_Q16(1)),
+		      -ENOMEM, "Channels limit not checked");
+
+	zassert_equal(knot_acq_start(&fake_adc, 12, INTERVAL_US, DECIMATION),
+		      0, "Start failed");
+	zassert_not_null(sequence, "Sequence not started");
+	zassert_equal(sequence->channels, BIT(1) | BIT(3), "Wrong channels");
+	zassert_equal(sequence->buffer_size, 2 * sizeof(s16_t),
+		      "Wrong buffer size");
+	zassert_equal(sequence->options->interval_us, INTERVAL_US,
+		      "Wrong interval");
+
+	zassert_false(knot_acq_get(1, &value), "Output before first block");
+	zassert_equal(knot_acq_add_channel(0, PROXY(0), KNOT_Q16(1)),
+		      -EINVAL, "Channel added while running");
+}
+
+static void test_decimation(void)
+{
+	s32_t value;
+
+	publish_count = 0;
+	wakeup_count = 0;
+
+	zassert_equal(sample(10, 100), ADC_ACTION_REPEAT, "Not repeated");
+	zassert_equal(sample(20, 100), ADC_ACTION_REPEAT, "Not repeated");
+	zassert_equal(sample(30, 100), ADC_ACTION_REPEAT, "Not repeated");
+	zassert_equal(publish_count, 0, "Published before block end");
+	zassert_equal(wakeup_count, 0, "Woken up before block end");
+
+	/* Means: 25 and 101, scaled by 1 and 0.5 */
+	zassert_equal(sample(40, 104), ADC_ACTION_REPEAT, "Not repeated");
+	zassert_equal(publish_count, 2, "Outputs not published");
+	zassert_equal(wakeup_count, 1, "loop() not woken up");
+	zassert_equal(published[0], KNOT_Q16(25), "Wrong channel 1 mean");
+	zassert_equal(published[1], KNOT_Q16(50.5), "Wrong channel 3 mean");
+
+	zassert_true(knot_acq_get(1, &value), "No channel 1 output");
+	zassert_equal(value, KNOT_Q16(25), "Wrong channel 1 output");
+	zassert_true(knot_acq_get(3, &value), "No channel 3 output");
+	zassert_equal(value, KNOT_Q16(50.5), "Wrong channel 3 output");
+	zassert_false(knot_acq_get(2, &value), "Unknown channel output");
+
+	/* Next block starts from zero */
+	sample(-8, 0);
+	sample(-8, 0);
+	sample(-8, 0);
+	sample(-8, 0);
+	zassert_equal(publish_count, 4, "Second block not published");
+	zassert_equal(published[0], KNOT_Q16(-8), "Wrong negative mean");
+	zassert_equal(published[1], 0, "Accumulator not cleared");
+}
+
+static void test_stop(void)
+{
+	publish_count = 0;
+
+	knot_acq_stop();
+	zassert_equal(sample(1, 1), ADC_ACTION_FINISH, "Not finished");
+	zassert_equal(publish_count, 0, "Published after stop");
+
+	/* Restart drops partial block and last outputs */
+	zassert_equal(knot_acq_start(&fake_adc, 12, INTERVAL_US, 2), 0,
+		      "Restart failed");
+	sample(6, 10);
+	sample(2, 10);
+	zassert_equal(publish_count, 2, "Not published after restart");
+	zassert_equal(published[0], KNOT_Q16(4), "Wrong mean after restart");
+	zassert_equal(published[1], KNOT_Q16(5), "Wrong mean after restart");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(acq,
+			 ztest_unit_test(test_start),
+			 ztest_unit_test(test_decimation),
+			 ztest_unit_test(test_stop));
+	ztest_run_test_suite(acq);
+}
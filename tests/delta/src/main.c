@@ -0,0 +1,279 @@
+/* main.c - Differential firmware update tests */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Patches are applied by delta.c against slots kept on RAM. Writes behave
+ * like NOR flash: bits can only be cleared, so writing over data not
+ * erased first corrupts it.
+ */
+
+#include <ztest.h>
+#include <string.h>
+#include <logging/log.h>
+#include <misc/byteorder.h>
+#include <flash_map.h>
+#include <dfu/flash_img.h>
+#include <dfu/mcuboot.h>
+#include <tinycrypt/sha256.h>
+#include <tinycrypt/constants.h>
+
+#include "delta.h"
+
+LOG_MODULE_REGISTER(knot_setup, LOG_LEVEL_DBG);
+
+#define SLOT_SIZE	4096
+#define SRC_SIZE	3000
+#define DST_SIZE	3200
+#define INSERT_LEN	700
+#define PATCH_MAX	1024
+#define CHUNK_LEN	7	/* Odd size to split header and ops */
+
+/* Simulated flash */
+static u8_t slots[2][SLOT_SIZE];
+static const struct flash_area areas[2] = {
+	{ .fa_id = DT_FLASH_AREA_IMAGE_0_ID, .fa_size = SLOT_SIZE },
+	{ .fa_id = DT_FLASH_AREA_IMAGE_1_ID, .fa_size = SLOT_SIZE },
+};
+static int upgrade_requests;
+
+static u8_t dst[DST_SIZE];
+static u8_t patch[PATCH_MAX];
+
+static int slot_idx(u8_t id)
+{
+	if (id == DT_FLASH_AREA_IMAGE_0_ID)
+		return 0;
+	if (id == DT_FLASH_AREA_IMAGE_1_ID)
+		return 1;
+	return -1;
+}
+
+int flash_area_open(u8_t id, const struct flash_area **fa)
+{
+	int idx = slot_idx(id);
+
+	if (idx < 0)
+		return -ENOENT;
+
+	*fa = &areas[idx];
+
+	return 0;
+}
+
+void flash_area_close(const struct flash_area *fa)
+{
+}
+
+int flash_area_read(const struct flash_area *fa, off_t off, void *dst,
+		    size_t len)
+{
+	if (off + len > fa->fa_size)
+		return -EINVAL;
+
+	memcpy(dst, &slots[slot_idx(fa->fa_id)][off], len);
+
+	return 0;
+}
+
+int flash_img_init(struct flash_img_context *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->flash_area = &areas[1];
+
+	return 0;
+}
+
+int flash_img_buffered_write(struct flash_img_context *ctx, u8_t *data,
+			     size_t len, bool flush)
+{
+	u8_t *slot = slots[1];
+	size_t i;
+
+	if (ctx->bytes_written + len > SLOT_SIZE)
+		return -EINVAL;
+
+	/* NOR flash: bits only go from 1 to 0 */
+	for (i = 0; i < len; i++)
+		slot[ctx->bytes_written + i] &= data[i];
+
+	ctx->bytes_written += len;
+
+	return 0;
+}
+
+int boot_erase_img_bank(u8_t area_id)
+{
+	int idx = slot_idx(area_id);
+
+	if (idx < 0)
+		return -ENOENT;
+
+	memset(slots[idx], 0xff, SLOT_SIZE);
+
+	return 0;
+}
+
+int boot_request_upgrade(int permanent)
+{
+	upgrade_requests++;
+
+	return 0;
+}
+
+static void sha256(const u8_t *data, size_t len, u8_t *digest)
+{
+	struct tc_sha256_state_struct sha;
+
+	tc_sha256_init(&sha);
+	tc_sha256_update(&sha, data, len);
+	tc_sha256_final(digest, &sha);
+}
+
+static size_t put_op(u8_t *buf, u8_t op, u32_t len, u32_t off)
+{
+	buf[0] = op;
+	sys_put_le32(len, &buf[1]);
+	sys_put_le32(off, &buf[5]);
+
+	return 9;
+}
+
+/*
+ * Target: source head, new data and source tail shifted. Slot 1 is
+ * left dirty, as if holding a previous image.
+ */
+static size_t make_patch(void)
+{
+	u8_t *src = slots[0];
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < SRC_SIZE; i++)
+		src[i] = (u8_t) (i * 7 + 3);
+
+	memcpy(dst, src, 1000);
+	for (i = 0; i < INSERT_LEN; i++)
+		dst[1000 + i] = (u8_t) (i ^ 0x5a);
+	memcpy(&dst[1000 + INSERT_LEN], &src[1500], 1500);
+
+	memset(slots[1], 0x00, SLOT_SIZE);
+	upgrade_requests = 0;
+
+	sys_put_le32(0x3146444b, &patch[0]);
+	sys_put_le32(SRC_SIZE, &patch[4]);
+	sys_put_le32(DST_SIZE, &patch[8]);
+	sha256(src, SRC_SIZE, &patch[12]);
+	sha256(dst, DST_SIZE, &patch[44]);
+	len = 76;
+
+	len += put_op(&patch[len], 0, 1000, 0);
+	len += put_op(&patch[len], 1, INSERT_LEN, 0);
+	memcpy(&patch[len], &dst[1000], INSERT_LEN);
+	len += INSERT_LEN;
+	len += put_op(&patch[len], 0, 1500, 1500);
+
+	return len;
+}
+
+static int send_patch(size_t len)
+{
+	size_t off;
+	size_t chunk;
+	int rc;
+
+	for (off = 0; off < len; off += chunk) {
+		chunk = MIN(CHUNK_LEN, len - off);
+		rc = delta_write(&patch[off], chunk);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static bool slot_erased(const u8_t *slot)
+{
+	int i;
+
+	for (i = 0; i < SLOT_SIZE; i++) {
+		if (slot[i] != 0xff)
+			return false;
+	}
+
+	return true;
+}
+
+static void test_apply(void)
+{
+	size_t len = make_patch();
+
+	zassert_equal(delta_start(), 0, "Start failed");
+	zassert_equal(send_patch(len), 0, "Patch refused");
+	zassert_equal(delta_finish(), 0, "Finish failed");
+
+	zassert_true(memcmp(slots[1], dst, DST_SIZE) == 0,
+		     "Rebuilt image differs from target");
+	zassert_equal(upgrade_requests, 1, "Upgrade not requested");
+}
+
+static void test_wrong_source(void)
+{
+	size_t len = make_patch();
+
+	/* Running image differs from the one patch was made against */
+	slots[0][10] ^= 0xff;
+
+	zassert_equal(delta_start(), 0, "Start failed");
+	zassert_not_equal(send_patch(len), 0, "Patch accepted");
+
+	delta_abort();
+	zassert_true(slot_erased(slots[1]), "Slot 1 not erased on abort");
+	zassert_equal(upgrade_requests, 0, "Upgrade requested");
+}
+
+static void test_wrong_target(void)
+{
+	size_t len = make_patch();
+
+	/* Rebuilt image won't match target hash */
+	patch[44] ^= 0xff;
+
+	zassert_equal(delta_start(), 0, "Start failed");
+	zassert_equal(send_patch(len), 0, "Patch refused");
+	zassert_not_equal(delta_finish(), 0, "Mismatch not detected");
+
+	delta_abort();
+	zassert_true(slot_erased(slots[1]), "Slot 1 not erased on abort");
+	zassert_equal(upgrade_requests, 0, "Upgrade requested");
+}
+
+static void test_restart(void)
+{
+	size_t len = make_patch();
+
+	/* Upload interrupted and started again from offset 0 */
+	zassert_equal(delta_start(), 0, "Start failed");
+	zassert_equal(send_patch(len / 2), 0, "Patch refused");
+
+	zassert_equal(delta_start(), 0, "Restart failed");
+	zassert_equal(send_patch(len), 0, "Patch refused");
+	zassert_equal(delta_finish(), 0, "Finish failed");
+
+	zassert_true(memcmp(slots[1], dst, DST_SIZE) == 0,
+		     "Rebuilt image differs from target");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(delta,
+			 ztest_unit_test(test_apply),
+			 ztest_unit_test(test_wrong_source),
+			 ztest_unit_test(test_wrong_target),
+			 ztest_unit_test(test_restart));
+	ztest_run_test_suite(delta);
+}
@@ -0,0 +1,92 @@
+/* main.c - PROTO/NET message ring tests */
+
+/*
+ * Copyright (c) 2019, CESAR. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ztest.h>
+#include <string.h>
+
+#include "ring.h"
+
+#define WAIT_TIME	K_MSEC(50)
+#define PUT_DELAY	K_MSEC(20)
+
+static struct ring ring;
+static u8_t buf[RING_SLOT_SIZE];
+
+static struct k_delayed_work put_work;
+
+static void put_msg(struct k_work *work)
+{
+	ring_put(&ring, "late", 4);
+}
+
+static void test_order(void)
+{
+	char msg[2] = "0";
+	int i;
+
+	ring_init(&ring);
+
+	for (i = 0; i < RING_SLOTS; i++, msg[0]++)
+		zassert_equal(ring_put(&ring, msg, sizeof(msg)), 0,
+			      "Put failed");
+	zassert_equal(ring_put(&ring, msg, sizeof(msg)), -ENOBUFS,
+		      "Full ring not detected");
+
+	for (i = 0, msg[0] = '0'; i < RING_SLOTS; i++, msg[0]++) {
+		zassert_equal(ring_get(&ring, buf, sizeof(buf), K_NO_WAIT),
+			      sizeof(msg), "Wrong length");
+		zassert_true(memcmp(buf, msg, sizeof(msg)) == 0,
+			     "Wrong message");
+	}
+	zassert_equal(ring_get(&ring, buf, sizeof(buf), K_NO_WAIT), 0,
+		      "Empty ring not detected");
+}
+
+static void test_stale_signal(void)
+{
+	s64_t start;
+
+	/* Read without waiting: wakeup signal is left given */
+	ring_init(&ring);
+	ring_put(&ring, "old", 3);
+	zassert_equal(ring_get(&ring, buf, sizeof(buf), K_NO_WAIT), 3,
+		      "Message not read");
+
+	start = k_uptime_get();
+	zassert_equal(ring_get(&ring, buf, sizeof(buf), WAIT_TIME), 0,
+		      "Message read from empty ring");
+	zassert_true(k_uptime_get() - start >= WAIT_TIME,
+		     "Returned before timeout");
+}
+
+static void test_wakeup(void)
+{
+	ring_init(&ring);
+	ring_put(&ring, "old", 3);
+	ring_get(&ring, buf, sizeof(buf), K_NO_WAIT);
+	k_delayed_work_init(&put_work, put_msg);
+
+	/* Put after the stale signal is taken */
+	k_delayed_work_submit(&put_work, PUT_DELAY);
+	zassert_equal(ring_get(&ring, buf, sizeof(buf), K_FOREVER), 4,
+		      "Waiter not woken up");
+	zassert_true(memcmp(buf, "late", 4) == 0, "Wrong message");
+
+	k_delayed_work_submit(&put_work, PUT_DELAY);
+	zassert_equal(ring_wait(&ring, WAIT_TIME), 0, "Wait timed out");
+	zassert_equal(ring_wait(&ring, K_NO_WAIT), 0, "Message lost");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(ring,
+			 ztest_unit_test(test_order),
+			 ztest_unit_test(test_stale_signal),
+			 ztest_unit_test(test_wakeup));
+	ztest_run_test_suite(ring);
+}